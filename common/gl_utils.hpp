@@ -0,0 +1,95 @@
+#pragma once
+// Функции GL 2.0+ нужны объявленными: либо GLEW подключён раньше (lab4), либо
+// заголовки GL подключаются с GL_GLEXT_PROTOTYPES (остальные лабораторные)
+#if !defined(__GLEW_H__) && !defined(GL_GLEXT_PROTOTYPES)
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <SFML/OpenGL.hpp>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <utility>
+
+// Версия контекста не ниже major.minor (по строке GL_VERSION)
+inline bool glVersionAtLeast(int major, int minor) {
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    int actualMajor = 0, actualMinor = 0;
+    if (!version || std::sscanf(version, "%d.%d", &actualMajor, &actualMinor) != 2)
+        return false;
+    return actualMajor > major || (actualMajor == major && actualMinor >= minor);
+}
+
+// Расширение по точному имени. С GL 3.0 список читается через glGetStringi:
+// в core-профиле glGetString(GL_EXTENSIONS) недоступен. В общей строке ищется
+// целое слово, чтобы имя не совпало с началом более длинного
+inline bool hasExtension(const char* name) {
+    if (glVersionAtLeast(3, 0)) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    const std::size_t length = std::strlen(name);
+    for (const char* found = extensions; found && (found = std::strstr(found, name)); found += length) {
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+// Компиляция шейдера; ошибки печатаются, объект возвращается в любом случае
+inline GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLchar infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+// Компиляция и компоновка в уже созданную программу; attributes - явные номера
+// атрибутов, задаются до компоновки. false (с выводом журнала) при ошибке
+inline bool linkShaders(GLuint program, const char* vertexSource, const char* fragmentSource,
+                        std::initializer_list<std::pair<GLuint, const char*>> attributes = {}) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    for (const auto& attribute : attributes)
+        glBindAttribLocation(program, attribute.first, attribute.second);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        GLchar infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Новая программа из двух шейдеров; 0, если она не скомпоновалась
+inline GLuint linkProgram(const char* vertexSource, const char* fragmentSource,
+                          std::initializer_list<std::pair<GLuint, const char*>> attributes = {}) {
+    GLuint program = glCreateProgram();
+    if (!linkShaders(program, vertexSource, fragmentSource, attributes)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с захватом работы. У каждого рабочего своя очередь: свои задачи
+// он берёт с конца (последние добавленные, "горячие" в кэше), чужие крадёт с
+// начала. Поток, ожидающий группу задач, не спит, а выполняет задачи сам,
+// поэтому задачи могут запускать вложенные parallelFor без взаимоблокировок.
+class JobSystem {
+public:
+    // Счётчик незавершённых задач группы
+    struct Counter {
+        std::atomic<int> pending{0};
+    };
+
+    // workers = 0 - всё выполняется в вызывающем потоке внутри wait()
+    explicit JobSystem(unsigned workers = defaultWorkerCount()) : queues(workers + 1) {
+        for (auto& queue : queues)
+            queue = std::make_unique<Queue>();
+        for (unsigned i = 0; i < workers; ++i)
+            threads.emplace_back([this, i] { workerLoop(i + 1); });
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static unsigned defaultWorkerCount() {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    // Рабочие потоки плюс вызывающий
+    unsigned getThreadCount() const { return static_cast<unsigned>(threads.size()) + 1; }
+
+    void run(Counter& counter, std::function<void()> job) {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        // Рабочий кладёт задачу в свою очередь, внешние потоки - в общую (нулевую)
+        Queue& queue = *queues[currentQueue() < queues.size() ? currentQueue() : 0];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back({std::move(job), &counter});
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        // Пустой захват мьютекса не даёт уведомлению проскочить между
+        // проверкой условия рабочим и его засыпанием
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wakeUp.notify_one();
+    }
+
+    // Ожидание группы с выполнением любых доступных задач
+    void wait(Counter& counter) {
+        while (counter.pending.load(std::memory_order_acquire) > 0) {
+            if (!runOne(currentQueue()))
+                std::this_thread::yield();
+        }
+    }
+
+    // body(begin, end) для отрезков [0, count) длиной не больше grain
+    template <typename Body>
+    void parallelFor(std::size_t count, std::size_t grain, const Body& body) {
+        if (count == 0)
+            return;
+        if (threads.empty() || count <= grain) {
+            body(std::size_t(0), count);
+            return;
+        }
+        Counter counter;
+        for (std::size_t begin = grain; begin < count; begin += grain) {
+            std::size_t end = begin + grain < count ? begin + grain : count;
+            run(counter, [&body, begin, end] { body(begin, end); });
+        }
+        body(std::size_t(0), grain);
+        wait(counter);
+    }
+
+private:
+    struct Job {
+        std::function<void()> function;
+        Counter* counter;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    // Индекс очереди текущего потока; для потоков вне пула - 0
+    static std::size_t& currentQueue() {
+        static thread_local std::size_t index = 0;
+        return index;
+    }
+
+    bool pop(std::size_t index, Job& job, bool steal) {
+        Queue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            return false;
+        if (steal) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        } else {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        return true;
+    }
+
+    bool runOne(std::size_t self) {
+        Job job;
+        bool found = pop(self, job, false);
+        for (std::size_t i = 1; !found && i < queues.size(); ++i)
+            found = pop((self + i) % queues.size(), job, true);
+        if (!found)
+            return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        job.function();
+        job.counter->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(std::size_t index) {
+        currentQueue() = index;
+        while (true) {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cmath>
+
+// Минимальная математика для lab2/lab3: матрицы 4x4 по столбцам, как в OpenGL,
+// чтобы их можно было передавать в glLoadMatrixf/glMultMatrixf без перестановки.
+
+struct Vec3 {
+    float x = 0, y = 0, z = 0;
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3 operator*(Vec3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(Vec3 a, Vec3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+inline Vec3 normalize(Vec3 v) {
+    float length = std::sqrt(dot(v, v));
+    return length > 0 ? v * (1.0f / length) : v;
+}
+
+struct Mat4 {
+    // m[столбец * 4 + строка]
+    float m[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    float& at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+};
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+    Mat4 result;
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0;
+            for (int k = 0; k < 4; ++k)
+                sum += a.at(row, k) * b.at(k, column);
+            result.at(row, column) = sum;
+        }
+    }
+    return result;
+}
+
+inline Vec3 transformPoint(const Mat4& a, Vec3 p) {
+    return {a.at(0, 0) * p.x + a.at(0, 1) * p.y + a.at(0, 2) * p.z + a.at(0, 3),
+            a.at(1, 0) * p.x + a.at(1, 1) * p.y + a.at(1, 2) * p.z + a.at(1, 3),
+            a.at(2, 0) * p.x + a.at(2, 1) * p.y + a.at(2, 2) * p.z + a.at(2, 3)};
+}
+
+inline Mat4 translation(float x, float y, float z) {
+    Mat4 result;
+    result.at(0, 3) = x;
+    result.at(1, 3) = y;
+    result.at(2, 3) = z;
+    return result;
+}
+
+inline Mat4 scaling(float x, float y, float z) {
+    Mat4 result;
+    result.at(0, 0) = x;
+    result.at(1, 1) = y;
+    result.at(2, 2) = z;
+    return result;
+}
+
+// То же, что glRotatef: угол в градусах, ось нормализуется
+inline Mat4 rotation(float degrees, float x, float y, float z) {
+    Vec3 axis = normalize({x, y, z});
+    float radians = degrees * 3.14159265358979f / 180.0f;
+    float c = std::cos(radians), s = std::sin(radians), t = 1 - c;
+    Mat4 result;
+    result.at(0, 0) = t * axis.x * axis.x + c;
+    result.at(0, 1) = t * axis.x * axis.y - s * axis.z;
+    result.at(0, 2) = t * axis.x * axis.z + s * axis.y;
+    result.at(1, 0) = t * axis.x * axis.y + s * axis.z;
+    result.at(1, 1) = t * axis.y * axis.y + c;
+    result.at(1, 2) = t * axis.y * axis.z - s * axis.x;
+    result.at(2, 0) = t * axis.x * axis.z - s * axis.y;
+    result.at(2, 1) = t * axis.y * axis.z + s * axis.x;
+    result.at(2, 2) = t * axis.z * axis.z + c;
+    return result;
+}
+
+// То же, что gluPerspective
+inline Mat4 perspective(float fovyDegrees, float aspect, float zNear, float zFar) {
+    float f = 1.0f / std::tan(fovyDegrees * 3.14159265358979f / 360.0f);
+    Mat4 result;
+    result.at(0, 0) = f / aspect;
+    result.at(1, 1) = f;
+    result.at(2, 2) = (zFar + zNear) / (zNear - zFar);
+    result.at(2, 3) = 2 * zFar * zNear / (zNear - zFar);
+    result.at(3, 2) = -1;
+    result.at(3, 3) = 0;
+    return result;
+}
+
+// То же, что gluLookAt
+inline Mat4 lookAt(Vec3 eye, Vec3 center, Vec3 up) {
+    Vec3 f = normalize(center - eye);
+    Vec3 s = normalize(cross(f, up));
+    Vec3 u = cross(s, f);
+    Mat4 result;
+    result.at(0, 0) = s.x; result.at(0, 1) = s.y; result.at(0, 2) = s.z;
+    result.at(1, 0) = u.x; result.at(1, 1) = u.y; result.at(1, 2) = u.z;
+    result.at(2, 0) = -f.x; result.at(2, 1) = -f.y; result.at(2, 2) = -f.z;
+    return result * translation(-eye.x, -eye.y, -eye.z);
+}
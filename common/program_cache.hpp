@@ -0,0 +1,206 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+
+// Дисковый кэш двоичных образов шейдерных программ (glGetProgramBinary /
+// glProgramBinary). Ключ - FNV-1a от исходников и строк GL_VENDOR, GL_RENDERER,
+// GL_VERSION: после смены драйвера или видеокарты ключ другой, и программа
+// собирается заново. Драйвер вправе отвергнуть и подходящий по ключу образ,
+// тогда load() возвращает false и вызывающий компилирует исходники как обычно.
+// Функции GL берутся через sf::Context::getFunction, поэтому кэш работает и
+// без GLEW. Создаётся при активном контексте (после создания окна).
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory = ".shader_cache") : directory(std::move(directory)) {
+        getProgramBinary = reinterpret_cast<GetProgramBinaryFunction>(sf::Context::getFunction("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinaryFunction>(sf::Context::getFunction("glProgramBinary"));
+        programParameteri = reinterpret_cast<ProgramParameteriFunction>(sf::Context::getFunction("glProgramParameteri"));
+        getProgramiv = reinterpret_cast<GetProgramivFunction>(sf::Context::getFunction("glGetProgramiv"));
+        linkProgram = reinterpret_cast<LinkProgramFunction>(sf::Context::getFunction("glLinkProgram"));
+
+        // Драйвер может поддерживать функции, но не давать ни одного формата
+        GLint formats = 0;
+        if (getProgramBinary && programBinary && programParameteri && getProgramiv && linkProgram)
+            glGetIntegerv(numProgramBinaryFormats, &formats);
+        supported = formats > 0;
+
+        for (GLenum name : {GLenum(GL_VENDOR), GLenum(GL_RENDERER), GLenum(GL_VERSION)}) {
+            const GLubyte* text = glGetString(name);
+            if (text)
+                driver += reinterpret_cast<const char*>(text);
+            driver += '\n';
+        }
+    }
+
+    bool isSupported() const { return supported; }
+
+    // Ключ для набора исходников (с уже вставленными #define) в текущем драйвере
+    std::uint64_t makeKey(std::initializer_list<std::string> sources) const {
+        std::uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const std::string& text) {
+            for (unsigned char c : text)
+                hash = (hash ^ c) * 1099511628211ull;
+            // Граница между строками, чтобы "ab"+"c" и "a"+"bc" давали разные ключи
+            hash = (hash ^ 0xffu) * 1099511628211ull;
+        };
+        mix(driver);
+        for (const std::string& source : sources)
+            mix(source);
+        return hash;
+    }
+
+    bool contains(std::uint64_t key) const {
+        struct stat info;
+        return supported && stat(pathFor(key).c_str(), &info) == 0;
+    }
+
+    // Перед glLinkProgram: образ программы понадобится после компоновки
+    void prepare(GLuint program) const {
+        if (supported)
+            programParameteri(program, programBinaryRetrievableHint, GL_TRUE);
+    }
+
+    // Загрузка образа в program; false - образа нет или драйвер его не принял
+    bool load(GLuint program, std::uint64_t key) {
+        if (!supported)
+            return false;
+        const std::string path = pathFor(key);
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+        std::ifstream file(path, std::ios::binary);
+        FileHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "LPRG", 4) != 0 ||
+            header.version != fileVersion || header.key != key)
+            return false;
+        // Размер из заголовка должен совпасть с файлом, иначе испорченная запись
+        // заставила бы выделить до 4 ГБ
+        if (static_cast<std::uint64_t>(info.st_size) != sizeof(header) + static_cast<std::uint64_t>(header.size))
+            return false;
+        std::vector<char> blob(header.size);
+        if (!file.read(blob.data(), static_cast<std::streamsize>(blob.size())))
+            return false;
+        programBinary(program, header.format, blob.data(), static_cast<GLsizei>(blob.size()));
+        GLint linked = GL_FALSE;
+        getProgramiv(program, linkStatus, &linked);
+        if (linked != GL_TRUE)
+            return false;
+        ++hits;
+        return true;
+    }
+
+    // Сохранение образа скомпонованной program. Если её компоновали без
+    // prepare() и драйвер образ не сохранил, программа компонуется повторно.
+    bool store(GLuint program, std::uint64_t key) {
+        if (!supported)
+            return false;
+        ++misses;
+        GLint length = 0;
+        getProgramiv(program, programBinaryLength, &length);
+        if (length <= 0) {
+            prepare(program);
+            linkProgram(program);
+            getProgramiv(program, programBinaryLength, &length);
+            if (length <= 0)
+                return false;
+        }
+        std::vector<char> blob(length);
+        FileHeader header;
+        std::memcpy(header.magic, "LPRG", 4);
+        header.key = key;
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &header.format, blob.data());
+        header.size = static_cast<std::uint32_t>(written);
+
+        // Запись во временный файл и переименование: параллельно запущенная
+        // лабораторная не прочитает недописанный образ
+        mkdir(directory.c_str(), 0755);
+        std::string path = pathFor(key);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(blob.data(), written);
+            if (!file)
+                return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // Программы, взятые из кэша, и собранные из исходников с записью в кэш
+    int getHits() const { return hits; }
+    int getMisses() const { return misses; }
+
+private:
+    // Имена с префиксом GL_ могут уже быть макросами GLEW, поэтому свои
+    static constexpr GLenum programBinaryRetrievableHint = 0x8257;
+    static constexpr GLenum programBinaryLength = 0x8741;
+    static constexpr GLenum numProgramBinaryFormats = 0x87FE;
+    static constexpr GLenum linkStatus = 0x8B82;
+    static constexpr std::uint32_t fileVersion = 1;
+
+    using GetProgramBinaryFunction = void(APIENTRY*)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+    using ProgramBinaryFunction = void(APIENTRY*)(GLuint, GLenum, const void*, GLsizei);
+    using ProgramParameteriFunction = void(APIENTRY*)(GLuint, GLenum, GLint);
+    using GetProgramivFunction = void(APIENTRY*)(GLuint, GLenum, GLint*);
+    using LinkProgramFunction = void(APIENTRY*)(GLuint);
+
+    struct FileHeader {
+        char magic[4] = {};
+        std::uint32_t version = fileVersion;
+        std::uint64_t key = 0;
+        GLenum format = 0;
+        std::uint32_t size = 0;
+    };
+
+    std::string directory;
+    std::string driver;
+    bool supported = false;
+    int hits = 0;
+    int misses = 0;
+    GetProgramBinaryFunction getProgramBinary = nullptr;
+    ProgramBinaryFunction programBinary = nullptr;
+    ProgramParameteriFunction programParameteri = nullptr;
+    GetProgramivFunction getProgramiv = nullptr;
+    LinkProgramFunction linkProgram = nullptr;
+
+    std::string pathFor(std::uint64_t key) const {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return directory + "/" + name;
+    }
+};
+
+// sf::Shader::loadFromFile через кэш (вершинный или фрагментный шейдер).
+// При попадании SFML собирает шейдер-заглушку, чтобы создать объект
+// программы, а настоящий образ подменяет его через glProgramBinary.
+inline bool loadShaderCached(sf::Shader& shader, const std::string& path, sf::Shader::Type type, ProgramCache& cache) {
+    std::ifstream file(path);
+    if (!file || type == sf::Shader::Geometry || !cache.isSupported())
+        return shader.loadFromFile(path, type);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string source = text.str();
+
+    std::uint64_t key = cache.makeKey({source, type == sf::Shader::Vertex ? "vertex" : "fragment"});
+    if (cache.contains(key)) {
+        const char* stub = type == sf::Shader::Vertex ? "void main() { gl_Position = vec4(0.0); }"
+                                                       : "void main() { gl_FragColor = vec4(0.0); }";
+        if (shader.loadFromMemory(stub, type) && cache.load(shader.getNativeHandle(), key))
+            return true;
+    }
+    if (!shader.loadFromMemory(source, type))
+        return false;
+    cache.store(shader.getNativeHandle(), key);
+    return true;
+}
@@ -0,0 +1,354 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#include "math.hpp"
+#include "job_system.hpp"
+
+// Вершина для программного растеризатора: позиция в локальных координатах и цвет
+struct SoftVertex {
+    float x, y, z;
+    float r, g, b;
+};
+
+// Программный растеризатор для тех же сцен, что рисуются через OpenGL.
+// Правила повторяют GL: отсечение по ближней и дальней плоскостям, центры
+// пикселей в (x + 0.5, y + 0.5), правило "верхнего левого ребра", вершины
+// на сетке 1/256 пикселя, GL_LESS и перспективно-корректный цвет. Грани не
+// отбрасываются, как и в лабораторных (GL_CULL_FACE выключен).
+// Кадр считается в два параллельных прохода: треугольники преобразуются и
+// раскладываются по экранным плиткам 64x64, затем каждая плитка со своим
+// участком буфера глубины растеризуется отдельной задачей, по 4 пикселя за
+// шаг (SSE2). Порядок треугольников внутри плитки совпадает с порядком отрисовки.
+class SoftRasterizer {
+public:
+    static constexpr int tileSize = 64;
+
+    SoftRasterizer(int width, int height, JobSystem& jobs)
+        : width(width), height(height), pitch((width + 3) & ~3), jobs(jobs),
+          tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize),
+          color(static_cast<std::size_t>(pitch) * height), depth(static_cast<std::size_t>(tilesX) * tilesY * tileSize * tileSize) {}
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    void setClearColor(float r, float g, float b) { clearColor = packColor(r, g, b); }
+
+    // Треугольники (по три вершины подряд) с матрицей projection * view * model.
+    // vertices должен жить до flush().
+    void draw(const std::vector<SoftVertex>& vertices, const Mat4& mvp) { draws.push_back({&vertices, mvp}); }
+
+    // Очистка, растеризация всех накопленных вызовов и сброс списка
+    void flush() {
+        std::size_t chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(draws.size(), jobs.getThreadCount() * 4));
+        if (chunks.size() < chunkCount)
+            chunks.resize(chunkCount);
+        for (std::size_t c = 0; c < chunkCount; ++c) {
+            chunks[c].triangles.clear();
+            chunks[c].bins.resize(static_cast<std::size_t>(tilesX) * tilesY);
+            for (auto& bin : chunks[c].bins)
+                bin.clear();
+        }
+
+        // Вызовы делятся на непрерывные куски, поэтому порядок сохраняется
+        jobs.parallelFor(chunkCount, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t c = begin; c < end; ++c) {
+                std::size_t first = draws.size() * c / chunkCount, last = draws.size() * (c + 1) / chunkCount;
+                for (std::size_t d = first; d < last; ++d)
+                    processDraw(draws[d], chunks[c]);
+            }
+        });
+
+        jobs.parallelFor(static_cast<std::size_t>(tilesX) * tilesY, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t tile = begin; tile < end; ++tile) {
+                clearTile(static_cast<int>(tile));
+                for (std::size_t c = 0; c < chunkCount; ++c) {
+                    for (std::uint32_t index : chunks[c].bins[tile])
+                        rasterize(chunks[c].triangles[index], static_cast<int>(tile));
+                }
+            }
+        });
+        draws.clear();
+    }
+
+    // Цвет пикселя (0xAABBGGRR); y отсчитывается снизу, как в окне GL
+    std::uint32_t getPixel(int x, int y) const { return color[static_cast<std::size_t>(y) * pitch + x]; }
+
+    // Двоичный PPM (P6), строки сверху вниз
+    bool savePpm(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> row(static_cast<std::size_t>(width) * 3);
+        for (int y = height - 1; y >= 0; --y) {
+            for (int x = 0; x < width; ++x) {
+                std::uint32_t p = getPixel(x, y);
+                row[x * 3 + 0] = static_cast<unsigned char>(p & 0xFF);
+                row[x * 3 + 1] = static_cast<unsigned char>((p >> 8) & 0xFF);
+                row[x * 3 + 2] = static_cast<unsigned char>((p >> 16) & 0xFF);
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct Draw {
+        const std::vector<SoftVertex>* vertices;
+        Mat4 mvp;
+    };
+
+    // Вершина в пространстве отсечения
+    struct ClipVertex {
+        float x, y, z, w;
+        float r, g, b;
+    };
+
+    // Плоскость a * x + b * y + c над экраном (x, y - центр пикселя). Свободный
+    // член хранится в double и переносится к углу плитки, чтобы внутри плитки
+    // считать в float с малыми координатами без потери точности.
+    struct Plane {
+        float a, b;
+        double c;
+        Plane relativeTo(int x, int y) const { return {a, b, a * static_cast<double>(x) + b * static_cast<double>(y) + c}; }
+        float at(float x, float y) const { return a * x + b * y + static_cast<float>(c); }
+    };
+
+    struct Triangle {
+        Plane edges[3];
+        bool inclusive[3];
+        Plane z, invW, r, g, b;
+        int minX, minY, maxX, maxY;
+    };
+
+    struct Chunk {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<std::uint32_t>> bins;
+    };
+
+    int width, height, pitch;
+    JobSystem& jobs;
+    int tilesX, tilesY;
+    std::vector<std::uint32_t> color;
+    std::vector<float> depth;
+    std::uint32_t clearColor = 0xFF000000;
+    std::vector<Draw> draws;
+    std::vector<Chunk> chunks;
+
+    // Как при записи в 8-битный буфер GL: округление c * 255
+    static std::uint32_t packColor(float r, float g, float b) {
+        auto channel = [](float c) { return static_cast<std::uint32_t>(std::lround(std::min(std::max(c, 0.0f), 1.0f) * 255.0f)); };
+        return channel(r) | channel(g) << 8 | channel(b) << 16 | 0xFF000000u;
+    }
+
+    void processDraw(const Draw& draw, Chunk& chunk) const {
+        const std::vector<SoftVertex>& vertices = *draw.vertices;
+        const Mat4& m = draw.mvp;
+        for (std::size_t i = 0; i + 2 < vertices.size(); i += 3) {
+            ClipVertex polygon[5];
+            for (int k = 0; k < 3; ++k) {
+                const SoftVertex& v = vertices[i + k];
+                polygon[k] = {m.at(0, 0) * v.x + m.at(0, 1) * v.y + m.at(0, 2) * v.z + m.at(0, 3),
+                              m.at(1, 0) * v.x + m.at(1, 1) * v.y + m.at(1, 2) * v.z + m.at(1, 3),
+                              m.at(2, 0) * v.x + m.at(2, 1) * v.y + m.at(2, 2) * v.z + m.at(2, 3),
+                              m.at(3, 0) * v.x + m.at(3, 1) * v.y + m.at(3, 2) * v.z + m.at(3, 3),
+                              v.r, v.g, v.b};
+            }
+            // Все три вершины за одной боковой плоскостью - треугольник не виден
+            bool rejected = false;
+            for (int axis = 0; axis < 2 && !rejected; ++axis) {
+                auto coord = [axis](const ClipVertex& v) { return axis == 0 ? v.x : v.y; };
+                rejected = (coord(polygon[0]) > polygon[0].w && coord(polygon[1]) > polygon[1].w && coord(polygon[2]) > polygon[2].w)
+                        || (coord(polygon[0]) < -polygon[0].w && coord(polygon[1]) < -polygon[1].w && coord(polygon[2]) < -polygon[2].w);
+            }
+            if (rejected)
+                continue;
+
+            int count = clip(polygon, 3, 1.0f);
+            count = clip(polygon, count, -1.0f);
+            for (int k = 1; k + 1 < count; ++k)
+                setup(polygon[0], polygon[k], polygon[k + 1], chunk);
+        }
+    }
+
+    // Отсечение многоугольника плоскостью z * side <= w (side = -1 - ближняя, 1 - дальняя)
+    static int clip(ClipVertex* polygon, int count, float side) {
+        if (count < 3)
+            return 0;
+        ClipVertex input[5];
+        std::copy(polygon, polygon + count, input);
+        int result = 0;
+        for (int i = 0; i < count; ++i) {
+            const ClipVertex& a = input[i];
+            const ClipVertex& b = input[(i + 1) % count];
+            float da = a.w - side * a.z, db = b.w - side * b.z;
+            if (da >= 0)
+                polygon[result++] = a;
+            if ((da >= 0) != (db >= 0) && result < 5) {
+                float t = da / (da - db);
+                auto lerp = [t](float x, float y) { return x + (y - x) * t; };
+                polygon[result++] = {lerp(a.x, b.x), lerp(a.y, b.y), lerp(a.z, b.z), lerp(a.w, b.w),
+                                     lerp(a.r, b.r), lerp(a.g, b.g), lerp(a.b, b.b)};
+            }
+        }
+        return result;
+    }
+
+    void setup(const ClipVertex& c0, const ClipVertex& c1, const ClipVertex& c2, Chunk& chunk) const {
+        struct ScreenVertex {
+            float x, y, z, invW, r, g, b;
+        };
+        auto toScreen = [this](const ClipVertex& c) {
+            float invW = 1.0f / c.w;
+            // Вершины на сетке 1/256 пикселя, как у аппаратных растеризаторов
+            float x = std::round((c.x * invW * 0.5f + 0.5f) * width * 256.0f) / 256.0f;
+            float y = std::round((c.y * invW * 0.5f + 0.5f) * height * 256.0f) / 256.0f;
+            return ScreenVertex{x, y, c.z * invW * 0.5f + 0.5f, invW, c.r * invW, c.g * invW, c.b * invW};
+        };
+        ScreenVertex v[3] = {toScreen(c0), toScreen(c1), toScreen(c2)};
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (area == 0)
+            return;
+        // Обход против часовой стрелки: внутри все рёбра положительны
+        if (area < 0) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        Triangle t;
+        float minX = std::min({v[0].x, v[1].x, v[2].x}), maxX = std::max({v[0].x, v[1].x, v[2].x});
+        float minY = std::min({v[0].y, v[1].y, v[2].y}), maxY = std::max({v[0].y, v[1].y, v[2].y});
+        // Пиксели, центры которых попадают в рамку треугольника
+        t.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+        t.maxX = std::min(width - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+        t.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+        t.maxY = std::min(height - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+
+        // Ребро i лежит напротив вершины i
+        for (int i = 0; i < 3; ++i) {
+            const ScreenVertex& a = v[(i + 1) % 3];
+            const ScreenVertex& b = v[(i + 2) % 3];
+            t.edges[i] = {a.y - b.y, b.x - a.x, static_cast<double>(a.x) * b.y - static_cast<double>(a.y) * b.x};
+            // Левое ребро или горизонтальное верхнее (ось y направлена вверх)
+            t.inclusive[i] = t.edges[i].a > 0 || (t.edges[i].a == 0 && t.edges[i].b < 0);
+        }
+        // Барицентрические координаты - рёбра, делённые на удвоенную площадь,
+        // поэтому любой линейный по экрану атрибут - тоже плоскость
+        float invArea = 1.0f / area;
+        auto attribute = [&](float a0, float a1, float a2) {
+            Plane p;
+            p.a = (t.edges[0].a * a0 + t.edges[1].a * a1 + t.edges[2].a * a2) * invArea;
+            p.b = (t.edges[0].b * a0 + t.edges[1].b * a1 + t.edges[2].b * a2) * invArea;
+            p.c = a0 - static_cast<double>(p.a) * v[0].x - static_cast<double>(p.b) * v[0].y;
+            return p;
+        };
+        t.z = attribute(v[0].z, v[1].z, v[2].z);
+        t.invW = attribute(v[0].invW, v[1].invW, v[2].invW);
+        t.r = attribute(v[0].r, v[1].r, v[2].r);
+        t.g = attribute(v[0].g, v[1].g, v[2].g);
+        t.b = attribute(v[0].b, v[1].b, v[2].b);
+
+        std::uint32_t index = static_cast<std::uint32_t>(chunk.triangles.size());
+        chunk.triangles.push_back(t);
+        for (int ty = t.minY / tileSize; ty <= t.maxY / tileSize; ++ty) {
+            for (int tx = t.minX / tileSize; tx <= t.maxX / tileSize; ++tx)
+                chunk.bins[static_cast<std::size_t>(ty) * tilesX + tx].push_back(index);
+        }
+    }
+
+    void clearTile(int tile) {
+        int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+        int x1 = std::min(x0 + tileSize, pitch), y1 = std::min(y0 + tileSize, height);
+        for (int y = y0; y < y1; ++y)
+            std::fill(&color[static_cast<std::size_t>(y) * pitch + x0], &color[static_cast<std::size_t>(y) * pitch + x1], clearColor);
+        float* tileDepth = &depth[static_cast<std::size_t>(tile) * tileSize * tileSize];
+        std::fill(tileDepth, tileDepth + tileSize * tileSize, 1.0f);
+    }
+
+    // Участок треугольника внутри плитки; pitch и плитки кратны 4, поэтому
+    // четвёрка пикселей никогда не выходит за свою плитку
+    void rasterize(const Triangle& t, int tile) {
+        int tileX = (tile % tilesX) * tileSize, tileY = (tile / tilesX) * tileSize;
+        int x0 = std::max(t.minX, tileX) & ~3, x1 = std::min(t.maxX, tileX + tileSize - 1);
+        int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + tileSize - 1);
+        float* tileDepth = &depth[static_cast<std::size_t>(tile) * tileSize * tileSize];
+        // Дальше координаты отсчитываются от угла плитки
+        const Plane edges[3] = {t.edges[0].relativeTo(tileX, tileY), t.edges[1].relativeTo(tileX, tileY), t.edges[2].relativeTo(tileX, tileY)};
+        const Plane zPlane = t.z.relativeTo(tileX, tileY), invWPlane = t.invW.relativeTo(tileX, tileY);
+        const Plane rPlane = t.r.relativeTo(tileX, tileY), gPlane = t.g.relativeTo(tileX, tileY), bPlane = t.b.relativeTo(tileX, tileY);
+
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 scale = _mm_set1_ps(255.0f);
+        auto splat = [](float v) { return _mm_set1_ps(v); };
+        auto inside = [&](__m128 w, bool inclusive) { return inclusive ? _mm_cmpge_ps(w, zero) : _mm_cmpgt_ps(w, zero); };
+        auto toChannel = [&](__m128 c) {
+            return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c, zero), _mm_set1_ps(1.0f)), scale));
+        };
+        for (int y = y0; y <= y1; ++y) {
+            float py = static_cast<float>(y - tileY) + 0.5f;
+            std::uint32_t* row = &color[static_cast<std::size_t>(y) * pitch];
+            float* depthRow = tileDepth + (y - tileY) * tileSize - tileX;
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(splat(static_cast<float>(x - tileX)), lane);
+                auto plane = [&](const Plane& p) { return _mm_add_ps(_mm_mul_ps(splat(p.a), px), splat(p.b * py + static_cast<float>(p.c))); };
+                __m128 mask = _mm_and_ps(_mm_and_ps(inside(plane(edges[0]), t.inclusive[0]), inside(plane(edges[1]), t.inclusive[1])),
+                                         inside(plane(edges[2]), t.inclusive[2]));
+                if (_mm_movemask_ps(mask) == 0)
+                    continue;
+                if (x + 3 >= width)
+                    mask = _mm_and_ps(mask, _mm_cmplt_ps(_mm_add_ps(px, splat(static_cast<float>(tileX))), splat(static_cast<float>(width))));
+                __m128 z = plane(zPlane);
+                __m128 oldZ = _mm_loadu_ps(depthRow + x);
+                mask = _mm_and_ps(mask, _mm_cmplt_ps(z, oldZ));
+                if (_mm_movemask_ps(mask) == 0)
+                    continue;
+                _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, oldZ)));
+
+                __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), plane(invWPlane));
+                __m128i r = toChannel(_mm_mul_ps(plane(rPlane), w));
+                __m128i g = toChannel(_mm_mul_ps(plane(gPlane), w));
+                __m128i b = toChannel(_mm_mul_ps(plane(bPlane), w));
+                __m128i pixel = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                                             _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32(static_cast<int>(0xFF000000u))));
+                __m128i integerMask = _mm_castps_si128(mask);
+                __m128i* target = reinterpret_cast<__m128i*>(row + x);
+                __m128i old = _mm_loadu_si128(target);
+                _mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(integerMask, pixel), _mm_andnot_si128(integerMask, old)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; ++y) {
+            float py = static_cast<float>(y - tileY) + 0.5f;
+            std::uint32_t* row = &color[static_cast<std::size_t>(y) * pitch];
+            float* depthRow = tileDepth + (y - tileY) * tileSize - tileX;
+            for (int x = x0; x <= x1 && x < width; ++x) {
+                float px = static_cast<float>(x - tileX) + 0.5f;
+                bool covered = true;
+                for (int i = 0; i < 3; ++i) {
+                    float e = edges[i].at(px, py);
+                    covered = covered && (t.inclusive[i] ? e >= 0 : e > 0);
+                }
+                float z = zPlane.at(px, py);
+                if (!covered || !(z < depthRow[x]))
+                    continue;
+                depthRow[x] = z;
+                float w = 1.0f / invWPlane.at(px, py);
+                row[x] = packColor(rPlane.at(px, py) * w, gPlane.at(px, py) * w, bPlane.at(px, py) * w);
+            }
+        }
+#endif
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+// Пакетная отрисовка маркеров и кривых за два вызова draw.
+// Все маркеры - текстурированные квадраты в одном sf::VertexBuffer,
+// все кривые - отрезки в другом. Кривая занимает в буфере диапазон по своему
+// числу вершин (с запасом в четверть на рост); освободившиеся диапазоны
+// попадают в список свободных блоков, а когда их становится много, кривые
+// переупаковываются подряд. Вершины вне кривых вырождены в прозрачную точку.
+// На видеокарту отправляются только изменённые интервалы вершин.
+class BatchRenderer : public sf::Drawable {
+public:
+    BatchRenderer(std::size_t handleCount, std::size_t curveCount, float handleSize)
+        : handleSize(handleSize),
+          handleVertices(4 * handleCount),
+          curves(curveCount),
+          handleBuffer(sf::Quads, sf::VertexBuffer::Dynamic),
+          curveBuffer(sf::Lines, sf::VertexBuffer::Dynamic) {
+        useVertexBuffers = sf::VertexBuffer::isAvailable() && handleBuffer.create(handleVertices.size());
+        createHandleTexture();
+        markDirty(handleDirty, 0, handleVertices.size());
+    }
+
+    void setHandle(std::size_t id, sf::Vector2f position, sf::Color color) {
+        const float textureSize = static_cast<float>(handleTexture.getSize().x);
+        const sf::Vector2f corners[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        sf::Vertex* quad = &handleVertices[4 * id];
+        for (int i = 0; i < 4; ++i) {
+            quad[i].position = position + corners[i] * handleSize;
+            quad[i].texCoords = corners[i] * textureSize;
+            quad[i].color = color;
+        }
+        markDirty(handleDirty, 4 * id, 4 * id + 4);
+    }
+
+    // Переводит ломаную (LineStrip) в отрезки диапазона кривой.
+    // Диапазон переносится, только если ломаная в него не помещается или стала вдвое короче
+    void setCurve(std::size_t id, const std::vector<sf::Vertex>& strip) {
+        std::size_t needed = strip.size() >= 2 ? 2 * (strip.size() - 1) : 0;
+        CurveRange& range = curves[id];
+        if (needed > range.capacity || needed < range.capacity / 2) {
+            release(range);
+            range.capacity = (needed + needed / 4 + 1) / 2 * 2;
+            range.offset = allocate(range.capacity);
+        }
+        if (range.capacity == 0)
+            return;
+        sf::Vertex* first = &curveVertices[range.offset];
+        for (std::size_t i = 1; i < strip.size(); ++i) {
+            first[2 * i - 2] = strip[i - 1];
+            first[2 * i - 1] = strip[i];
+        }
+        std::fill(first + needed, first + std::max(needed, range.count), degenerate());
+        markDirty(curveDirty, range.offset, range.offset + std::max(needed, range.count));
+        range.count = needed;
+    }
+
+    // Отключение кривых, когда их рисует GpuCurveRenderer
+    void setDrawCurves(bool value) { drawCurves = value; }
+
+    // Вершины кривых: занятые отрезками и всего в рисуемом диапазоне
+    std::size_t getCurveVertexCount() const {
+        std::size_t used = 0;
+        for (const CurveRange& range : curves)
+            used += range.count;
+        return used;
+    }
+    std::size_t getCurveRangeSize() const { return curveEnd; }
+
+    // Выгрузка изменённых интервалов в буферы
+    void flush() {
+        if (freeTotal > compactionMinimum && freeTotal > curveEnd / 4)
+            compact();
+        if (useVertexBuffers) {
+            if (curveBufferSize < curveEnd) {
+                // Буфер растёт с запасом, после пересоздания выгружается целиком
+                curveBufferSize = std::max(curveEnd, 2 * curveBufferSize);
+                curveVertices.resize(curveBufferSize, degenerate());
+                useVertexBuffers = curveBuffer.create(curveBufferSize);
+                curveDirty.clear();
+                markDirty(curveDirty, 0, curveBufferSize);
+            }
+            upload(handleBuffer, handleVertices, handleDirty);
+            upload(curveBuffer, curveVertices, curveDirty);
+        }
+        handleDirty.clear();
+        curveDirty.clear();
+    }
+
+protected:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
+        if (useVertexBuffers) {
+            if (drawCurves && curveEnd > 0)
+                target.draw(curveBuffer, 0, curveEnd, states);
+            states.texture = &handleTexture;
+            target.draw(handleBuffer, states);
+        } else {
+            if (drawCurves)
+                target.draw(curveVertices.data(), curveEnd, sf::Lines, states);
+            states.texture = &handleTexture;
+            target.draw(handleVertices.data(), handleVertices.size(), sf::Quads, states);
+        }
+    }
+
+private:
+    // Диапазон кривой: count вершин отрезков, остаток до capacity вырожден
+    struct CurveRange {
+        std::size_t offset = 0;
+        std::size_t count = 0;
+        std::size_t capacity = 0;
+    };
+    // Полуинтервал [first, second) вершин
+    using Interval = std::pair<std::size_t, std::size_t>;
+
+    // Свободное место, после которого кривые переупаковываются
+    static constexpr std::size_t compactionMinimum = 1024;
+    // Интервалы с промежутком меньше этого выгружаются одним вызовом
+    static constexpr std::size_t mergeGap = 64;
+
+    float handleSize;
+    std::vector<sf::Vertex> handleVertices;
+    std::vector<sf::Vertex> curveVertices;
+    std::vector<CurveRange> curves;
+    // Свободные блоки в [0, curveEnd), по возрастанию смещения, соседние слиты
+    std::vector<Interval> freeBlocks;
+    std::size_t freeTotal = 0;
+    std::size_t curveEnd = 0;
+    std::size_t curveBufferSize = 0;
+    sf::VertexBuffer handleBuffer;
+    sf::VertexBuffer curveBuffer;
+    sf::Texture handleTexture;
+    bool useVertexBuffers = false;
+    bool drawCurves = true;
+    std::vector<Interval> handleDirty;
+    std::vector<Interval> curveDirty;
+
+    static sf::Vertex degenerate() { return sf::Vertex(sf::Vector2f(), sf::Color::Transparent); }
+
+    static void markDirty(std::vector<Interval>& intervals, std::size_t first, std::size_t last) {
+        if (first < last)
+            intervals.emplace_back(first, last);
+    }
+
+    // Интервалы сортируются и сливаются; каждый слитый - один вызов update
+    static void upload(sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices, std::vector<Interval>& intervals) {
+        std::sort(intervals.begin(), intervals.end());
+        for (std::size_t i = 0; i < intervals.size();) {
+            Interval merged = intervals[i++];
+            while (i < intervals.size() && intervals[i].first <= merged.second + mergeGap)
+                merged.second = std::max(merged.second, intervals[i++].second);
+            buffer.update(&vertices[merged.first], merged.second - merged.first, static_cast<unsigned>(merged.first));
+        }
+    }
+
+    // Первый подходящий свободный блок, иначе место в конце диапазона
+    std::size_t allocate(std::size_t size) {
+        if (size == 0)
+            return 0;
+        for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block) {
+            if (block->second - block->first < size)
+                continue;
+            std::size_t offset = block->first;
+            block->first += size;
+            if (block->first == block->second)
+                freeBlocks.erase(block);
+            freeTotal -= size;
+            return offset;
+        }
+        std::size_t offset = curveEnd;
+        curveEnd += size;
+        if (curveVertices.size() < curveEnd)
+            curveVertices.resize(curveEnd, degenerate());
+        return offset;
+    }
+
+    // Вершины диапазона вырождаются, блок сливается с соседними свободными
+    void release(CurveRange& range) {
+        if (range.capacity == 0)
+            return;
+        std::fill(&curveVertices[range.offset], &curveVertices[range.offset] + range.count, degenerate());
+        markDirty(curveDirty, range.offset, range.offset + range.count);
+        Interval block(range.offset, range.offset + range.capacity);
+        range.count = range.capacity = 0;
+
+        auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), block);
+        if (next != freeBlocks.end() && next->first == block.second) {
+            block.second = next->second;
+            freeTotal -= next->second - next->first;
+            next = freeBlocks.erase(next);
+        }
+        if (next != freeBlocks.begin() && std::prev(next)->second == block.first) {
+            --next;
+            block.first = next->first;
+            freeTotal -= next->second - next->first;
+            next = freeBlocks.erase(next);
+        }
+        if (block.second == curveEnd) {
+            // Хвост просто укорачивает рисуемый диапазон
+            curveEnd = block.first;
+            return;
+        }
+        freeBlocks.insert(next, block);
+        freeTotal += block.second - block.first;
+    }
+
+    // Кривые сдвигаются подряд в порядке смещений, свободных блоков не остаётся
+    void compact() {
+        std::vector<std::size_t> order;
+        for (std::size_t id = 0; id < curves.size(); ++id) {
+            if (curves[id].capacity > 0)
+                order.push_back(id);
+        }
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return curves[a].offset < curves[b].offset; });
+        std::size_t end = 0;
+        for (std::size_t id : order) {
+            CurveRange& range = curves[id];
+            // Блоки только сдвигаются к началу, поэтому копирование вперёд безопасно
+            std::copy(&curveVertices[range.offset], &curveVertices[range.offset] + range.capacity, &curveVertices[end]);
+            range.offset = end;
+            end += range.capacity;
+        }
+        std::fill(curveVertices.begin() + end, curveVertices.begin() + curveEnd, degenerate());
+        curveDirty.clear();
+        markDirty(curveDirty, 0, curveEnd);
+        curveEnd = end;
+        freeBlocks.clear();
+        freeTotal = 0;
+    }
+
+    // Белый круг с прозрачным фоном, цвет задаётся вершинами
+    void createHandleTexture() {
+        const unsigned size = 32;
+        sf::Image image;
+        image.create(size, size, sf::Color::Transparent);
+        const float center = size / 2.0f;
+        for (unsigned y = 0; y < size; ++y) {
+            for (unsigned x = 0; x < size; ++x) {
+                float dx = x + 0.5f - center, dy = y + 0.5f - center;
+                float coverage = std::min(std::max(center - std::sqrt(dx * dx + dy * dy), 0.0f), 1.0f);
+                image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255)));
+            }
+        }
+        handleTexture.loadFromImage(image);
+        handleTexture.setSmooth(true);
+    }
+};
@@ -0,0 +1,239 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "spline.hpp"
+
+// Ближайшая к запросу точка на кривых
+struct CurveHit {
+    int segment = -1;
+    float t = 0;
+    sf::Vector2f point;
+    float distance = std::numeric_limits<float>::max();
+};
+
+// Иерархия ограничивающих прямоугольников над сегментами SplineBatch.
+// Прямоугольник сегмента строится по выпуклой оболочке четырёх контрольных
+// точек и гарантированно содержит кривую. При движении точек дерево не
+// перестраивается, а только уточняет прямоугольники снизу вверх.
+class CurveBvh {
+public:
+    void build(const SplineBatch& spline) {
+        std::size_t count = spline.size();
+        nodes.clear();
+        leafOf.assign(count, 0);
+        order.resize(count);
+        bounds.resize(count);
+        centers.resize(count);
+        for (std::size_t s = 0; s < count; ++s) {
+            order[s] = static_cast<std::uint32_t>(s);
+            bounds[s] = segmentBox(spline, s);
+            centers[s] = {(bounds[s].minX + bounds[s].maxX) / 2, (bounds[s].minY + bounds[s].maxY) / 2};
+        }
+        if (count > 0) {
+            nodes.reserve(2 * count - 1);
+            buildNode(0, count, -1);
+        }
+        marked.assign(nodes.size(), false);
+    }
+
+    // Обновление после сдвига точек одного сегмента: O(глубина дерева)
+    void refit(const SplineBatch& spline, std::size_t segment) {
+        int node = static_cast<int>(leafOf[segment]);
+        nodes[node].box = segmentBox(spline, segment);
+        for (node = nodes[node].parent; node >= 0; node = nodes[node].parent) {
+            Box merged = Box::merge(nodes[nodes[node].left].box, nodes[nodes[node].right].box);
+            if (merged == nodes[node].box)
+                break;
+            nodes[node].box = merged;
+        }
+    }
+
+    // Обновление после сдвига точек нескольких сегментов. Пересчитываются только
+    // их листья и предки тех листьев, чей прямоугольник изменился, каждый узел
+    // один раз: предки обходятся по убыванию номера (дети идут после родителей)
+    void refit(const SplineBatch& spline, const std::vector<std::uint32_t>& segments) {
+        touched.clear();
+        for (std::uint32_t segment : segments) {
+            int node = static_cast<int>(leafOf[segment]);
+            Box box = segmentBox(spline, segment);
+            if (box == nodes[node].box)
+                continue;
+            nodes[node].box = box;
+            for (node = nodes[node].parent; node >= 0 && !marked[node]; node = nodes[node].parent) {
+                marked[node] = true;
+                touched.push_back(node);
+            }
+        }
+        std::sort(touched.begin(), touched.end(), [](int a, int b) { return a > b; });
+        for (int node : touched) {
+            nodes[node].box = Box::merge(nodes[nodes[node].left].box, nodes[nodes[node].right].box);
+            marked[node] = false;
+        }
+    }
+
+    // Обновление всех прямоугольников за один проход (дети идут после родителей)
+    void refitAll(const SplineBatch& spline) {
+        for (int node = static_cast<int>(nodes.size()) - 1; node >= 0; --node) {
+            Node& n = nodes[node];
+            n.box = n.left < 0 ? segmentBox(spline, n.segment) : Box::merge(nodes[n.left].box, nodes[n.right].box);
+        }
+    }
+
+    // Поиск ближайшей точки на кривых не дальше maxDistance от запроса
+    CurveHit closestPoint(const SplineBatch& spline, sf::Vector2f query, float maxDistance) const {
+        CurveHit best;
+        best.distance = maxDistance;
+        if (nodes.empty())
+            return best;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& n = nodes[stack[--top]];
+            if (n.box.distance(query) > best.distance)
+                continue;
+            if (n.left < 0) {
+                closestOnSegment(spline, n.segment, query, best);
+                continue;
+            }
+            // Сначала обходим ближний потомок, чтобы быстрее сузить радиус поиска
+            int nearChild = n.left, farChild = n.right;
+            if (nodes[farChild].box.distance(query) < nodes[nearChild].box.distance(query))
+                std::swap(nearChild, farChild);
+            stack[top++] = farChild;
+            stack[top++] = nearChild;
+        }
+        return best;
+    }
+
+private:
+    struct Box {
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+
+        static Box merge(const Box& a, const Box& b) {
+            return {std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY)};
+        }
+        float distance(sf::Vector2f p) const {
+            float dx = std::max({minX - p.x, 0.0f, p.x - maxX});
+            float dy = std::max({minY - p.y, 0.0f, p.y - maxY});
+            return std::sqrt(dx * dx + dy * dy);
+        }
+        bool operator==(const Box& o) const { return minX == o.minX && minY == o.minY && maxX == o.maxX && maxY == o.maxY; }
+    };
+
+    struct Node {
+        Box box;
+        int parent = -1;
+        int left = -1, right = -1;
+        std::uint32_t segment = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> leafOf;
+    // Внутренние узлы, ожидающие пересчёта в refit() по списку сегментов
+    std::vector<bool> marked;
+    std::vector<int> touched;
+    // Временные данные построения
+    std::vector<std::uint32_t> order;
+    std::vector<Box> bounds;
+    std::vector<sf::Vector2f> centers;
+
+    static Box segmentBox(const SplineBatch& spline, std::size_t s) {
+        sf::Vector2f p = spline.getPoint(s, 0);
+        Box box{p.x, p.y, p.x, p.y};
+        for (int k = 1; k < 4; ++k) {
+            p = spline.getPoint(s, k);
+            box.minX = std::min(box.minX, p.x);
+            box.minY = std::min(box.minY, p.y);
+            box.maxX = std::max(box.maxX, p.x);
+            box.maxY = std::max(box.maxY, p.y);
+        }
+        return box;
+    }
+
+    // Разбиение по медиане центров вдоль длинной стороны
+    int buildNode(std::size_t first, std::size_t last, int parent) {
+        int index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        nodes[index].parent = parent;
+        if (last - first == 1) {
+            nodes[index].segment = order[first];
+            nodes[index].box = bounds[order[first]];
+            leafOf[order[first]] = static_cast<std::uint32_t>(index);
+            return index;
+        }
+        Box box = bounds[order[first]];
+        for (std::size_t i = first + 1; i < last; ++i)
+            box = Box::merge(box, bounds[order[i]]);
+        bool splitX = box.maxX - box.minX >= box.maxY - box.minY;
+        std::size_t middle = (first + last) / 2;
+        std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+            [&](std::uint32_t a, std::uint32_t b) {
+                return splitX ? centers[a].x < centers[b].x : centers[a].y < centers[b].y;
+            });
+        int left = buildNode(first, middle, index);
+        int right = buildNode(middle, last, index);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        nodes[index].box = box;
+        return index;
+    }
+
+    // Грубый поиск по равномерным отсчётам (их число растёт с длиной контрольного
+    // многоугольника) и уточнение методом Ньютона для f(t) = (B(t) - q) . B'(t) = 0
+    // из каждого локального минимума отсчётов
+    static void closestOnSegment(const SplineBatch& spline, std::size_t s, sf::Vector2f q, CurveHit& best) {
+        const sf::Vector2f p0 = spline.getPoint(s, 0), p1 = spline.getPoint(s, 1);
+        const sf::Vector2f p2 = spline.getPoint(s, 2), p3 = spline.getPoint(s, 3);
+        auto at = [&](float t) {
+            float u = 1 - t;
+            return u * u * u * p0 + 3 * u * u * t * p1 + 3 * u * t * t * p2 + t * t * t * p3;
+        };
+        auto derivative = [&](float t) {
+            float u = 1 - t;
+            return 3 * u * u * (p1 - p0) + 6 * u * t * (p2 - p1) + 3 * t * t * (p3 - p2);
+        };
+        auto secondDerivative = [&](float t) {
+            return 6 * (1 - t) * (p2 - 2.0f * p1 + p0) + 6 * t * (p3 - 2.0f * p2 + p1);
+        };
+        auto dot = [](sf::Vector2f a, sf::Vector2f b) { return a.x * b.x + a.y * b.y; };
+        auto length = [&](sf::Vector2f v) { return std::sqrt(dot(v, v)); };
+
+        const float polygonLength = length(p1 - p0) + length(p2 - p1) + length(p3 - p2);
+        const int samples = std::min(std::max(static_cast<int>(polygonLength / 4), 8), 64);
+        float distance2[65];
+        for (int i = 0; i <= samples; ++i) {
+            sf::Vector2f d = at(static_cast<float>(i) / samples) - q;
+            distance2[i] = dot(d, d);
+        }
+        for (int i = 0; i <= samples; ++i) {
+            if ((i > 0 && distance2[i - 1] < distance2[i]) || (i < samples && distance2[i + 1] < distance2[i]))
+                continue;
+            float t = static_cast<float>(i) / samples;
+            for (int iteration = 0; iteration < 4; ++iteration) {
+                sf::Vector2f d = at(t) - q;
+                sf::Vector2f d1 = derivative(t);
+                float denominator = dot(d1, d1) + dot(d, secondDerivative(t));
+                if (std::abs(denominator) < 1e-6f)
+                    break;
+                t = std::min(std::max(t - dot(d, d1) / denominator, 0.0f), 1.0f);
+            }
+            sf::Vector2f d = at(t) - q;
+            if (dot(d, d) > distance2[i]) {
+                t = static_cast<float>(i) / samples;
+                d = at(t) - q;
+            }
+            float distance = std::sqrt(dot(d, d));
+            if (distance < best.distance) {
+                best.segment = static_cast<int>(s);
+                best.t = t;
+                best.point = at(t);
+                best.distance = distance;
+            }
+        }
+    }
+};
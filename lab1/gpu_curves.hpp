@@ -0,0 +1,190 @@
+#pragma once
+#define GL_GLEXT_PROTOTYPES
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include "../common/gl_utils.hpp"
+#include "spline.hpp"
+
+// Вычисление кривых в вершинном шейдере, все сегменты - один вызов отрисовки.
+// В статическом буфере лежат параметры t для 2 * steps вершин отрезков одной
+// кривой, во втором буфере - контрольные точки всех сегментов, по два vec4
+// (p0, p1) и (p2, p3), которые подаются как атрибуты экземпляра (делитель 1).
+// update() сравнивает точки с уже загруженными и отправляет на видеокарту
+// только изменившиеся сегменты.
+class GpuCurveRenderer {
+public:
+    // Требуется OpenGL 3.3 (или ARB_instanced_arrays + ARB_draw_instanced)
+    static bool isAvailable() {
+        if (!sf::Shader::isAvailable())
+            return false;
+        return glVersionAtLeast(3, 3) || (hasExtension("GL_ARB_instanced_arrays") && hasExtension("GL_ARB_draw_instanced"));
+    }
+
+    explicit GpuCurveRenderer(int steps = 64, sf::Color color = sf::Color::White) : steps(steps), color(color) {
+        if (!isAvailable())
+            return;
+        std::vector<GLfloat> params;
+        params.reserve(2 * steps);
+        for (int i = 0; i < steps; ++i) {
+            params.push_back(static_cast<float>(i) / steps);
+            params.push_back(static_cast<float>(i + 1) / steps);
+        }
+        glGenBuffers(1, &paramVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, paramVbo);
+        glBufferData(GL_ARRAY_BUFFER, params.size() * sizeof(GLfloat), params.data(), GL_STATIC_DRAW);
+        glGenBuffers(1, &controlVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        program = createProgram();
+        ready = program != 0;
+        if (ready) {
+            projectionLocation = glGetUniformLocation(program, "projection");
+            colorLocation = glGetUniformLocation(program, "color");
+        }
+    }
+
+    ~GpuCurveRenderer() {
+        if (program)
+            glDeleteProgram(program);
+        if (paramVbo)
+            glDeleteBuffers(1, &paramVbo);
+        if (controlVbo)
+            glDeleteBuffers(1, &controlVbo);
+    }
+
+    GpuCurveRenderer(const GpuCurveRenderer&) = delete;
+    GpuCurveRenderer& operator=(const GpuCurveRenderer&) = delete;
+
+    bool isReady() const { return ready; }
+
+    // Загрузка контрольных точек: 8 чисел на сегмент, выгружаются только изменившиеся
+    // сегменты (интервалы с промежутком не больше mergeGap - одним вызовом)
+    void update(const SplineBatch& spline) {
+        if (!ready)
+            return;
+        segmentCount = spline.size();
+        glBindBuffer(GL_ARRAY_BUFFER, controlVbo);
+        if (segmentCount * floatsPerSegment > controlPoints.size()) {
+            // Буфер растёт с запасом и выгружается целиком
+            controlPoints.resize(std::max(segmentCount, 2 * controlPoints.size() / floatsPerSegment) * floatsPerSegment);
+            for (std::size_t s = 0; s < segmentCount; ++s)
+                pack(spline, s, &controlPoints[s * floatsPerSegment]);
+            glBufferData(GL_ARRAY_BUFFER, controlPoints.size() * sizeof(GLfloat), controlPoints.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return;
+        }
+
+        intervals.clear();
+        for (std::size_t s = 0; s < segmentCount; ++s) {
+            GLfloat packed[floatsPerSegment];
+            pack(spline, s, packed);
+            GLfloat* stored = &controlPoints[s * floatsPerSegment];
+            if (std::memcmp(packed, stored, sizeof(packed)) == 0)
+                continue;
+            std::memcpy(stored, packed, sizeof(packed));
+            if (!intervals.empty() && s <= intervals.back().second + mergeGap) {
+                intervals.back().second = s + 1;
+            } else {
+                intervals.emplace_back(s, s + 1);
+            }
+        }
+        for (const auto& interval : intervals) {
+            glBufferSubData(GL_ARRAY_BUFFER, interval.first * floatsPerSegment * sizeof(GLfloat),
+                            (interval.second - interval.first) * floatsPerSegment * sizeof(GLfloat),
+                            &controlPoints[interval.first * floatsPerSegment]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Рисование в текущем виде target; состояние SFML после этого сбрасывается
+    void draw(sf::RenderTarget& target) const {
+        if (!ready || segmentCount == 0 || !target.setActive(true))
+            return;
+        glUseProgram(program);
+        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, target.getView().getTransform().getMatrix());
+        glUniform4f(colorLocation, color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+
+        glBindBuffer(GL_ARRAY_BUFFER, paramVbo);
+        glEnableVertexAttribArray(paramLocation);
+        glVertexAttribPointer(paramLocation, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, controlVbo);
+        for (int i = 0; i < 2; ++i) {
+            glEnableVertexAttribArray(controlLocations[i]);
+            glVertexAttribDivisor(controlLocations[i], 1);
+            glVertexAttribPointer(controlLocations[i], 4, GL_FLOAT, GL_FALSE, floatsPerSegment * sizeof(GLfloat),
+                                  (void*)(i * 4 * sizeof(GLfloat)));
+        }
+
+        glDrawArraysInstanced(GL_LINES, 0, 2 * steps, static_cast<GLsizei>(segmentCount));
+
+        for (GLuint location : controlLocations) {
+            glVertexAttribDivisor(location, 0);
+            glDisableVertexAttribArray(location);
+        }
+        glDisableVertexAttribArray(paramLocation);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+        target.resetGLStates();
+    }
+
+private:
+    static constexpr std::size_t floatsPerSegment = 8;
+    static constexpr std::size_t mergeGap = 16;
+    // Параметр t - в слоте 0 (без него профиль совместимости может не рисовать),
+    // контрольные точки - в слотах 6 и 7, которые не совпадают со встроенными
+    // атрибутами (gl_Color, gl_MultiTexCoord), используемыми SFML
+    static constexpr GLuint paramLocation = 0;
+    static constexpr GLuint controlLocations[2] = {6, 7};
+
+    int steps;
+    sf::Color color;
+    bool ready = false;
+    GLuint program = 0;
+    GLuint paramVbo = 0;
+    GLuint controlVbo = 0;
+    GLint projectionLocation = -1;
+    GLint colorLocation = -1;
+    std::size_t segmentCount = 0;
+    std::vector<GLfloat> controlPoints;
+    // Изменившиеся сегменты последнего update(), [first, second)
+    std::vector<std::pair<std::size_t, std::size_t>> intervals;
+
+    static void pack(const SplineBatch& spline, std::size_t s, GLfloat* out) {
+        for (int k = 0; k < 4; ++k) {
+            sf::Vector2f p = spline.getPoint(s, k);
+            out[2 * k] = p.x;
+            out[2 * k + 1] = p.y;
+        }
+    }
+
+    static GLuint createProgram() {
+        const char* vertexSource = R"(
+#version 120
+uniform mat4 projection;
+attribute float parameter;
+attribute vec4 points01;
+attribute vec4 points23;
+
+void main() {
+    float t = parameter;
+    float u = 1.0 - t;
+    vec2 p = u * u * u * points01.xy + 3.0 * u * u * t * points01.zw + 3.0 * u * t * t * points23.xy + t * t * t * points23.zw;
+    gl_Position = projection * vec4(p, 0.0, 1.0);
+}
+)";
+        const char* fragmentSource = R"(
+#version 120
+uniform vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)";
+        return linkProgram(vertexSource, fragmentSource,
+                           {{paramLocation, "parameter"}, {controlLocations[0], "points01"}, {controlLocations[1], "points23"}});
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Равномерная сетка для поиска маркеров контрольных точек под курсором.
+// Маркер - квадрат со стороной size, левый верхний угол которого совпадает
+// с позицией точки. Маркер хранится в ячейке своего левого верхнего угла,
+// поэтому при cellSize >= size попадание проверяется максимум в 4 ячейках.
+class HandleGrid {
+public:
+    explicit HandleGrid(float size, float cellSize = 32.0f)
+        : size(size), cellSize(std::max(cellSize, size)) {}
+
+    void insert(std::uint32_t id, sf::Vector2f position) {
+        if (id >= entries.size())
+            entries.resize(id + 1);
+        Entry& entry = entries[id];
+        entry.position = position;
+        entry.cell = cellKey(position);
+        std::vector<std::uint32_t>& cell = cells[entry.cell];
+        entry.slot = static_cast<std::uint32_t>(cell.size());
+        cell.push_back(id);
+    }
+
+    // Инкрементальное обновление: ячейка меняется только при пересечении её границы
+    void move(std::uint32_t id, sf::Vector2f position) {
+        Entry& entry = entries[id];
+        entry.position = position;
+        std::uint64_t key = cellKey(position);
+        if (key == entry.cell)
+            return;
+        remove(id);
+        entry.cell = key;
+        std::vector<std::uint32_t>& cell = cells[key];
+        entry.slot = static_cast<std::uint32_t>(cell.size());
+        cell.push_back(id);
+    }
+
+    // Возвращает id ближайшего маркера, содержащего точку, или -1
+    int pick(sf::Vector2f point) const {
+        int result = -1;
+        float bestDistance = 0;
+        int x1 = cellCoord(point.x), y1 = cellCoord(point.y);
+        int x0 = cellCoord(point.x - size), y0 = cellCoord(point.y - size);
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                auto it = cells.find(packKey(cx, cy));
+                if (it == cells.end())
+                    continue;
+                for (std::uint32_t id : it->second) {
+                    sf::Vector2f d = point - entries[id].position;
+                    if (d.x < 0 || d.y < 0 || d.x > size || d.y > size)
+                        continue;
+                    float distance = (d.x - size / 2) * (d.x - size / 2) + (d.y - size / 2) * (d.y - size / 2);
+                    if (result < 0 || distance < bestDistance) {
+                        result = static_cast<int>(id);
+                        bestDistance = distance;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Entry {
+        sf::Vector2f position;
+        std::uint64_t cell = 0;
+        std::uint32_t slot = 0;
+    };
+
+    float size;
+    float cellSize;
+    std::vector<Entry> entries;
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+
+    int cellCoord(float v) const { return static_cast<int>(std::floor(v / cellSize)); }
+
+    static std::uint64_t packKey(int cx, int cy) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) | static_cast<std::uint32_t>(cy);
+    }
+
+    std::uint64_t cellKey(sf::Vector2f p) const { return packKey(cellCoord(p.x), cellCoord(p.y)); }
+
+    // Удаление из ячейки за O(1): на место удаляемого ставится последний элемент
+    void remove(std::uint32_t id) {
+        std::vector<std::uint32_t>& cell = cells[entries[id].cell];
+        std::uint32_t last = cell.back();
+        cell[entries[id].slot] = last;
+        entries[last].slot = entries[id].slot;
+        cell.pop_back();
+        if (cell.empty())
+            cells.erase(entries[id].cell);
+    }
+};
@@ -1,46 +1,217 @@
 #include <SFML/Graphics.hpp>
+#include "gpu_curves.hpp"
 #include <vector>
 #include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "tessellator.hpp"
+#include "spline.hpp"
+#include "handle_grid.hpp"
+#include "batch_renderer.hpp"
+#include "curve_bvh.hpp"
 
-struct Point {
-    sf::CircleShape shape;
-    sf::Vector2f position;
+// g++ -std=c++17 -O2 -march=native main.cpp -lsfml-graphics -lsfml-window -lsfml-system -lGL
+// ./a.out --bench [segments] - замер скорости вычисления сегментов
+// ./a.out --bench-gpu [segments] - сравнение вычисления кривых на CPU и в шейдере
+// G - переключение между CPU и GPU вычислением кривых
 
-    Point(float x, float y) {
-        position = {x, y};
-        shape.setRadius(5);
-        shape.setFillColor(sf::Color::Red);
-        shape.setPosition(position);
+const float handleRadius = 5;
+
+// Сравнение скалярного и SIMD-вычисления большого набора сегментов
+void runSplineBenchmark(std::size_t segmentCount) {
+    const int steps = 100;
+    const int iterations = 20;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(0.0f, 800.0f);
+    SplineBatch spline;
+    for (std::size_t i = 0; i < segmentCount; ++i) {
+        spline.addSegment({coord(rng), coord(rng)}, {coord(rng), coord(rng)},
+                          {coord(rng), coord(rng)}, {coord(rng), coord(rng)});
+    }
+    FloatBuffer outX((steps + 1) * spline.stride()), outY((steps + 1) * spline.stride());
+
+    auto measure = [&](bool simd) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            if (simd) {
+                spline.animate(i * 0.1f);
+                spline.evaluate(steps, outX.data(), outY.data());
+            } else {
+                spline.animateScalar(i * 0.1f);
+                spline.evaluateScalar(steps, outX.data(), outY.data());
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return segmentCount * iterations / elapsed.count();
+    };
+
+    double scalarRate = measure(false);
+    double simdRate = measure(true);
+    std::cout << "segments: " << segmentCount << ", samples per segment: " << steps + 1 << std::endl;
+    std::cout << "scalar: " << scalarRate << " segments/s" << std::endl;
+    std::cout << SplineBatch::simdName() << ": " << simdRate << " segments/s (x" << simdRate / scalarRate << ")" << std::endl;
+
+    // Поиск ближайшей точки на кривых: короткие сегменты, разбросанные по большой сцене
+    const int queries = 10000;
+    const float sceneSize = 20000.0f;
+    std::uniform_real_distribution<float> scene(0.0f, sceneSize), offset(-20.0f, 20.0f);
+    SplineBatch paths;
+    for (std::size_t i = 0; i < segmentCount; ++i) {
+        sf::Vector2f p0(scene(rng), scene(rng));
+        paths.addSegment(p0, p0 + sf::Vector2f(offset(rng), offset(rng)),
+                         p0 + sf::Vector2f(offset(rng), offset(rng)), p0 + sf::Vector2f(offset(rng), offset(rng)));
+    }
+    CurveBvh bvh;
+    bvh.build(paths);
+    // Замеряется только уточнение дерева, без сдвига точек
+    paths.animate(1.0f);
+    auto start = std::chrono::steady_clock::now();
+    bvh.refitAll(paths);
+    std::chrono::duration<double, std::milli> refitTime = std::chrono::steady_clock::now() - start;
+
+    // Сдвиг 1% сегментов: уточняются только их листья и предки
+    std::vector<std::uint32_t> moved;
+    std::uniform_int_distribution<std::size_t> pick(0, segmentCount - 1);
+    for (std::size_t i = 0; i < segmentCount / 100 + 1; ++i) {
+        std::size_t s = pick(rng);
+        paths.setPoint(s, 1, paths.getPoint(s, 1) + sf::Vector2f(offset(rng), offset(rng)));
+        moved.push_back(static_cast<std::uint32_t>(s));
     }
+    start = std::chrono::steady_clock::now();
+    bvh.refit(paths, moved);
+    std::chrono::duration<double, std::milli> partialRefitTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    int hits = 0;
+    for (int i = 0; i < queries; ++i)
+        hits += bvh.closestPoint(paths, {scene(rng), scene(rng)}, 10.0f).segment >= 0;
+    std::chrono::duration<double> queryTime = std::chrono::steady_clock::now() - start;
+    std::cout << "BVH refit: all " << refitTime.count() << " ms, " << moved.size() << " moved "
+              << partialRefitTime.count() << " ms, queries: " << queries / queryTime.count()
+              << " /s (" << hits << " hits)" << std::endl;
+}
+
+// Время кадра при вычислении кривых на CPU (с выгрузкой вершин) и в шейдере
+void runGpuBenchmark(std::size_t maxSegments) {
+    const int steps = 64;
+    const int frames = 20;
+
+    sf::RenderTexture target;
+    if (!target.create(800, 600) || !GpuCurveRenderer::isAvailable()) {
+        std::cerr << "Shaders or vertex buffers are not available" << std::endl;
+        return;
+    }
+    GpuCurveRenderer gpuCurves(steps);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(0.0f, 800.0f);
+    for (std::size_t segmentCount = 1; segmentCount <= maxSegments; segmentCount *= 10) {
+        SplineBatch spline;
+        for (std::size_t i = 0; i < segmentCount; ++i) {
+            spline.addSegment({coord(rng), coord(rng)}, {coord(rng), coord(rng)},
+                              {coord(rng), coord(rng)}, {coord(rng), coord(rng)});
+        }
+        FloatBuffer outX((steps + 1) * spline.stride()), outY((steps + 1) * spline.stride());
+        std::vector<sf::Vertex> lines(2 * steps * segmentCount);
+        sf::VertexBuffer lineBuffer(sf::Lines, sf::VertexBuffer::Stream);
+        lineBuffer.create(lines.size());
+
+        auto measure = [&](bool gpu) {
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; ++frame) {
+                spline.animate(frame * 0.1f);
+                target.clear();
+                if (gpu) {
+                    gpuCurves.update(spline);
+                    gpuCurves.draw(target);
+                } else {
+                    spline.evaluate(steps, outX.data(), outY.data());
+                    std::size_t n = spline.stride();
+                    for (std::size_t s = 0; s < segmentCount; ++s) {
+                        sf::Vertex* v = &lines[2 * steps * s];
+                        for (int i = 0; i < steps; ++i) {
+                            v[2 * i] = sf::Vertex({outX[i * n + s], outY[i * n + s]});
+                            v[2 * i + 1] = sf::Vertex({outX[(i + 1) * n + s], outY[(i + 1) * n + s]});
+                        }
+                    }
+                    lineBuffer.update(lines.data());
+                    target.draw(lineBuffer);
+                }
+                target.display();
+                glFinish();
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / frames;
+        };
 
-    void updatePosition(sf::Vector2f newPos) {
-        position = newPos;
-        shape.setPosition(position);
+        double cpuTime = measure(false);
+        double gpuTime = measure(true);
+        std::cout << "segments: " << segmentCount << ", CPU: " << cpuTime << " ms/frame, GPU: " << gpuTime << " ms/frame" << std::endl;
     }
-};
-
-sf::Vector2f bezierCurve(const std::vector<Point>& controlPoints, float t) {
-    float u = 1 - t;
-    return u * u * u * controlPoints[0].position +
-           3 * u * u * t * controlPoints[1].position +
-           3 * u * t * t * controlPoints[2].position +
-           t * t * t * controlPoints[3].position;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runSplineBenchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-gpu") {
+        runGpuBenchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000);
+        return 0;
+    }
+
     sf::RenderWindow window(sf::VideoMode(800, 600), "lab1");
     window.setFramerateLimit(60);
 
-    std::vector<Point> controlPoints = {
-        Point(100, 500),
-        Point(300, 100),
-        Point(500, 100),
-        Point(700, 500)
+    // Контрольные точки хранятся в SoA-буферах
+    SplineBatch spline;
+    spline.addSegment({100, 500}, {300, 100}, {500, 100}, {700, 500});
+
+    // Индекс маркеров для выбора точки мышью
+    HandleGrid handleGrid(2 * handleRadius);
+    for (std::size_t s = 0; s < spline.size(); ++s) {
+        for (int k = 0; k < 4; ++k)
+            handleGrid.insert(static_cast<std::uint32_t>(s * 4 + k), spline.getPoint(s, k));
+    }
+
+    // Ломаная перестраивается только при изменении контрольных точек
+    std::vector<CurveTessellator> tessellators(spline.size(), CurveTessellator(0.25f, sf::Color::White));
+
+    // Все маркеры и кривые рисуются двумя вызовами draw.
+    // Последний маркер показывает ближайшую к курсору точку кривой
+    const std::size_t hoverMarker = 4 * spline.size();
+    BatchRenderer renderer(4 * spline.size() + 1, spline.size(), 2 * handleRadius);
+    renderer.setHandle(hoverMarker, {}, sf::Color::Transparent);
+    for (std::size_t s = 0; s < spline.size(); ++s) {
+        for (int k = 0; k < 4; ++k)
+            renderer.setHandle(s * 4 + k, spline.getPoint(s, k), sf::Color::Red);
+    }
+    // Поиск кривой под курсором
+    CurveBvh curveBvh;
+    curveBvh.build(spline);
+    const float hoverDistance = 10;
+    sf::Vector2f mousePosition(-1000, -1000);
+    auto updateHover = [&] {
+        CurveHit hit = curveBvh.closestPoint(spline, mousePosition, hoverDistance);
+        sf::Vector2f corner = hit.point - sf::Vector2f(handleRadius, handleRadius);
+        renderer.setHandle(hoverMarker, corner, hit.segment >= 0 ? sf::Color::Yellow : sf::Color::Transparent);
     };
+    // Сегменты, сдвинутые анимацией в текущем кадре
+    std::vector<std::uint32_t> movedSegments;
+
+    // Вычисление кривых в вершинном шейдере; без шейдеров остаётся CPU-путь
+    GpuCurveRenderer gpuCurves;
+    bool useGpuCurves = false;
 
-    std::vector<sf::Vertex> bezierCurveVertices;
     sf::Clock clock;
     bool isAnimating = false;
+    // Перетаскиваемая точка: индекс сегмента * 4 + номер точки
+    int draggedHandle = -1;
 
     while (window.isOpen()) {
         sf::Event event;
@@ -50,49 +221,71 @@ int main() {
             if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space) {
                 isAnimating = !isAnimating;
             }
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::G && gpuCurves.isReady()) {
+                useGpuCurves = !useGpuCurves;
+                renderer.setDrawCurves(!useGpuCurves);
+            }
             if (event.type == sf::Event::MouseButtonPressed) {
-                for (auto& point : controlPoints) {
-                    if (point.shape.getGlobalBounds().contains(sf::Mouse::getPosition(window).x, sf::Mouse::getPosition(window).y)) {
-                        point.shape.setFillColor(sf::Color::Green);
-                    }
-                }
+                draggedHandle = handleGrid.pick({static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y)});
+                if (draggedHandle >= 0)
+                    renderer.setHandle(draggedHandle, spline.getPoint(draggedHandle / 4, draggedHandle % 4), sf::Color::Green);
+            }
+            if (event.type == sf::Event::MouseButtonReleased && draggedHandle >= 0) {
+                renderer.setHandle(draggedHandle, spline.getPoint(draggedHandle / 4, draggedHandle % 4), sf::Color::Red);
+                draggedHandle = -1;
             }
-            if (event.type == sf::Event::MouseButtonReleased) {
-                for (auto& point : controlPoints) {
-                    point.shape.setFillColor(sf::Color::Red);
+            if (event.type == sf::Event::MouseMoved && draggedHandle >= 0) {
+                sf::Vector2f newPos(event.mouseMove.x - handleRadius, event.mouseMove.y - handleRadius);
+                if (spline.setPoint(draggedHandle / 4, draggedHandle % 4, newPos)) {
+                    handleGrid.move(draggedHandle, newPos);
+                    renderer.setHandle(draggedHandle, newPos, sf::Color::Green);
+                    curveBvh.refit(spline, draggedHandle / 4);
+                    tessellators[draggedHandle / 4].invalidate();
                 }
             }
             if (event.type == sf::Event::MouseMoved) {
-                for (auto& point : controlPoints) {
-                    if (point.shape.getFillColor() == sf::Color::Green) {
-                        point.updatePosition({static_cast<float>(sf::Mouse::getPosition(window).x - 5), static_cast<float>(sf::Mouse::getPosition(window).y - 5)});
-                    }
-                }
+                mousePosition = {static_cast<float>(event.mouseMove.x), static_cast<float>(event.mouseMove.y)};
+                if (draggedHandle < 0)
+                    updateHover();
             }
         }
 
         if (isAnimating) {
-            float time = clock.getElapsedTime().asSeconds();
-            controlPoints[1].updatePosition({300 + std::sin(time) * 100, 100 + std::cos(time) * 50});
-            controlPoints[2].updatePosition({500 + std::cos(time) * 100, 100 + std::sin(time) * 50});
+            // animate() сдвигает внутренние точки всех сегментов
+            spline.animate(clock.getElapsedTime().asSeconds());
+            movedSegments.clear();
+            for (std::size_t s = 0; s < spline.size(); ++s) {
+                for (int k = 1; k <= 2; ++k) {
+                    std::size_t id = s * 4 + k;
+                    handleGrid.move(static_cast<std::uint32_t>(id), spline.getPoint(s, k));
+                    renderer.setHandle(id, spline.getPoint(s, k), static_cast<int>(id) == draggedHandle ? sf::Color::Green : sf::Color::Red);
+                }
+                tessellators[s].invalidate();
+                movedSegments.push_back(static_cast<std::uint32_t>(s));
+            }
+            curveBvh.refit(spline, movedSegments);
+            // Кривые уехали из-под курсора - маркер ближайшей точки пересчитывается
+            if (draggedHandle < 0)
+                updateHover();
         }
 
-        bezierCurveVertices.clear();
-        for (float t = 0; t <= 1; t += 0.01f) {
-            sf::Vector2f bezierPoint = bezierCurve(controlPoints, t);
-            bezierCurveVertices.emplace_back(bezierPoint, sf::Color::White);
+        // Перестраиваются и выгружаются только изменившиеся кривые
+        for (std::size_t s = 0; s < spline.size() && !useGpuCurves; ++s) {
+            if (tessellators[s].isDirty()) {
+                renderer.setCurve(s, tessellators[s].getVertices(
+                    spline.getPoint(s, 0), spline.getPoint(s, 1), spline.getPoint(s, 2), spline.getPoint(s, 3)));
+            }
         }
+        renderer.flush();
 
         window.clear();
-        
-        for (auto& point : controlPoints) {
-            window.draw(point.shape);
+        if (useGpuCurves) {
+            gpuCurves.update(spline);
+            gpuCurves.draw(window);
         }
-
-        window.draw(&bezierCurveVertices[0], bezierCurveVertices.size(), sf::PrimitiveType::LineStrip);
-        
+        window.draw(renderer);
         window.display();
     }
 
     return 0;
-}
\ No newline at end of file
+}
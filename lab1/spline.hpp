@@ -0,0 +1,231 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Аллокатор с выравниванием для SIMD-загрузок
+template <class T, std::size_t Alignment = 32>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) {
+        void* ptr = ::operator new(n * sizeof(T), std::align_val_t(Alignment));
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) { ::operator delete(ptr, std::align_val_t(Alignment)); }
+
+    bool operator==(const AlignedAllocator&) const { return true; }
+    bool operator!=(const AlignedAllocator&) const { return false; }
+};
+
+using FloatBuffer = std::vector<float, AlignedAllocator<float>>;
+
+// Набор кубических сегментов Безье в виде структуры массивов (SoA).
+// Координаты каждой из четырёх контрольных точек лежат в отдельных
+// непрерывных массивах, поэтому сегменты обрабатываются пачками по 4 (SSE)
+// или 8 (AVX2) штук. Размер массивов дополняется до кратного lanes нулями.
+class SplineBatch {
+public:
+    static constexpr std::size_t lanes = 8;
+
+    std::size_t addSegment(sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3) {
+        std::size_t index = count++;
+        if (count > stride()) {
+            std::size_t padded = (count + lanes - 1) / lanes * lanes;
+            for (int k = 0; k < 4; ++k) {
+                x[k].resize(padded, 0.0f);
+                y[k].resize(padded, 0.0f);
+            }
+            for (int k = 0; k < 2; ++k) {
+                restX[k].resize(padded, 0.0f);
+                restY[k].resize(padded, 0.0f);
+            }
+        }
+        const sf::Vector2f points[4] = {p0, p1, p2, p3};
+        for (int k = 0; k < 4; ++k) {
+            x[k][index] = points[k].x;
+            y[k][index] = points[k].y;
+        }
+        for (int k = 0; k < 2; ++k) {
+            restX[k][index] = points[k + 1].x;
+            restY[k][index] = points[k + 1].y;
+        }
+        return index;
+    }
+
+    std::size_t size() const { return count; }
+    // Длина SoA-массивов (с выравнивающим хвостом)
+    std::size_t stride() const { return x[0].size(); }
+
+    sf::Vector2f getPoint(std::size_t segment, int k) const { return {x[k][segment], y[k][segment]}; }
+
+    // Возвращает true, если точка действительно сдвинулась
+    bool setPoint(std::size_t segment, int k, sf::Vector2f p) {
+        if (x[k][segment] == p.x && y[k][segment] == p.y)
+            return false;
+        x[k][segment] = p.x;
+        y[k][segment] = p.y;
+        return true;
+    }
+
+    // Анимация внутренних точек вокруг исходных позиций:
+    // p1 = rest1 + (sin t * 100, cos t * 50), p2 = rest2 + (cos t * 100, sin t * 50)
+    void animateScalar(float time) {
+        float s = std::sin(time), c = std::cos(time);
+        for (std::size_t i = 0; i < count; ++i) {
+            x[1][i] = restX[0][i] + s * 100;
+            y[1][i] = restY[0][i] + c * 50;
+            x[2][i] = restX[1][i] + c * 100;
+            y[2][i] = restY[1][i] + s * 50;
+        }
+    }
+
+    void animate(float time) {
+#if defined(__AVX2__)
+        float s = std::sin(time), c = std::cos(time);
+        const __m256 dx1 = _mm256_set1_ps(s * 100), dy1 = _mm256_set1_ps(c * 50);
+        const __m256 dx2 = _mm256_set1_ps(c * 100), dy2 = _mm256_set1_ps(s * 50);
+        for (std::size_t i = 0; i < stride(); i += 8) {
+            _mm256_store_ps(&x[1][i], _mm256_add_ps(_mm256_load_ps(&restX[0][i]), dx1));
+            _mm256_store_ps(&y[1][i], _mm256_add_ps(_mm256_load_ps(&restY[0][i]), dy1));
+            _mm256_store_ps(&x[2][i], _mm256_add_ps(_mm256_load_ps(&restX[1][i]), dx2));
+            _mm256_store_ps(&y[2][i], _mm256_add_ps(_mm256_load_ps(&restY[1][i]), dy2));
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        float s = std::sin(time), c = std::cos(time);
+        const __m128 dx1 = _mm_set1_ps(s * 100), dy1 = _mm_set1_ps(c * 50);
+        const __m128 dx2 = _mm_set1_ps(c * 100), dy2 = _mm_set1_ps(s * 50);
+        for (std::size_t i = 0; i < stride(); i += 4) {
+            _mm_store_ps(&x[1][i], _mm_add_ps(_mm_load_ps(&restX[0][i]), dx1));
+            _mm_store_ps(&y[1][i], _mm_add_ps(_mm_load_ps(&restY[0][i]), dy1));
+            _mm_store_ps(&x[2][i], _mm_add_ps(_mm_load_ps(&restX[1][i]), dx2));
+            _mm_store_ps(&y[2][i], _mm_add_ps(_mm_load_ps(&restY[1][i]), dy2));
+        }
+#else
+        animateScalar(time);
+#endif
+    }
+
+    // Вычисление steps + 1 точек на каждом сегменте прямыми разностями.
+    // Результат хранится по образцам: out[i * stride() + segment],
+    // массивы outX/outY должны вмещать (steps + 1) * stride() элементов.
+    void evaluateScalar(int steps, float* outX, float* outY) const {
+        const float h = 1.0f / steps;
+        for (std::size_t s = 0; s < count; ++s) {
+            evaluateScalarAxis(x, s, h, steps, outX);
+            evaluateScalarAxis(y, s, h, steps, outY);
+        }
+    }
+
+    void evaluate(int steps, float* outX, float* outY) const {
+#if defined(__AVX2__)
+        evaluateAvx2(x, steps, outX);
+        evaluateAvx2(y, steps, outY);
+#elif defined(__SSE2__) || defined(_M_X64)
+        evaluateSse(x, steps, outX);
+        evaluateSse(y, steps, outY);
+#else
+        evaluateScalar(steps, outX, outY);
+#endif
+    }
+
+    static const char* simdName() {
+#if defined(__AVX2__)
+        return "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    std::size_t count = 0;
+    FloatBuffer x[4], y[4];
+    // Исходные позиции p1 и p2, относительно которых идёт анимация
+    FloatBuffer restX[2], restY[2];
+
+    // Начальные значения прямых разностей для P(t) = a t^3 + b t^2 + c t + d:
+    // f = d, df = a h^3 + b h^2 + c h, ddf = 6 a h^3 + 2 b h^2, dddf = 6 a h^3
+    static void evaluateScalarAxis(const FloatBuffer (&p)[4], std::size_t s, float h, int steps, float* out) {
+        std::size_t n = p[0].size();
+        float a = -p[0][s] + 3 * p[1][s] - 3 * p[2][s] + p[3][s];
+        float b = 3 * p[0][s] - 6 * p[1][s] + 3 * p[2][s];
+        float c = 3 * (p[1][s] - p[0][s]);
+        float h2 = h * h, h3 = h2 * h;
+        float f = p[0][s];
+        float df = a * h3 + b * h2 + c * h;
+        float ddf = 6 * a * h3 + 2 * b * h2;
+        float dddf = 6 * a * h3;
+        for (int i = 0; i <= steps; ++i) {
+            out[i * n + s] = f;
+            f += df;
+            df += ddf;
+            ddf += dddf;
+        }
+    }
+
+#if defined(__AVX2__)
+    static void evaluateAvx2(const FloatBuffer (&p)[4], int steps, float* out) {
+        std::size_t n = p[0].size();
+        const float h = 1.0f / steps;
+        const __m256 h1 = _mm256_set1_ps(h), h2 = _mm256_set1_ps(h * h), h3 = _mm256_set1_ps(h * h * h);
+        const __m256 two = _mm256_set1_ps(2.0f), three = _mm256_set1_ps(3.0f), six = _mm256_set1_ps(6.0f);
+        for (std::size_t s = 0; s < n; s += 8) {
+            __m256 p0 = _mm256_load_ps(&p[0][s]), p1 = _mm256_load_ps(&p[1][s]);
+            __m256 p2 = _mm256_load_ps(&p[2][s]), p3 = _mm256_load_ps(&p[3][s]);
+            __m256 a = _mm256_add_ps(_mm256_sub_ps(p3, p0), _mm256_mul_ps(three, _mm256_sub_ps(p1, p2)));
+            __m256 b = _mm256_mul_ps(three, _mm256_add_ps(_mm256_sub_ps(p0, _mm256_mul_ps(two, p1)), p2));
+            __m256 c = _mm256_mul_ps(three, _mm256_sub_ps(p1, p0));
+            __m256 ah3 = _mm256_mul_ps(a, h3), bh2 = _mm256_mul_ps(b, h2);
+            __m256 f = p0;
+            __m256 df = _mm256_add_ps(_mm256_add_ps(ah3, bh2), _mm256_mul_ps(c, h1));
+            __m256 dddf = _mm256_mul_ps(six, ah3);
+            __m256 ddf = _mm256_add_ps(dddf, _mm256_mul_ps(two, bh2));
+            for (int i = 0; i <= steps; ++i) {
+                _mm256_store_ps(out + i * n + s, f);
+                f = _mm256_add_ps(f, df);
+                df = _mm256_add_ps(df, ddf);
+                ddf = _mm256_add_ps(ddf, dddf);
+            }
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    static void evaluateSse(const FloatBuffer (&p)[4], int steps, float* out) {
+        std::size_t n = p[0].size();
+        const float h = 1.0f / steps;
+        const __m128 h1 = _mm_set1_ps(h), h2 = _mm_set1_ps(h * h), h3 = _mm_set1_ps(h * h * h);
+        const __m128 two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f), six = _mm_set1_ps(6.0f);
+        for (std::size_t s = 0; s < n; s += 4) {
+            __m128 p0 = _mm_load_ps(&p[0][s]), p1 = _mm_load_ps(&p[1][s]);
+            __m128 p2 = _mm_load_ps(&p[2][s]), p3 = _mm_load_ps(&p[3][s]);
+            __m128 a = _mm_add_ps(_mm_sub_ps(p3, p0), _mm_mul_ps(three, _mm_sub_ps(p1, p2)));
+            __m128 b = _mm_mul_ps(three, _mm_add_ps(_mm_sub_ps(p0, _mm_mul_ps(two, p1)), p2));
+            __m128 c = _mm_mul_ps(three, _mm_sub_ps(p1, p0));
+            __m128 ah3 = _mm_mul_ps(a, h3), bh2 = _mm_mul_ps(b, h2);
+            __m128 f = p0;
+            __m128 df = _mm_add_ps(_mm_add_ps(ah3, bh2), _mm_mul_ps(c, h1));
+            __m128 dddf = _mm_mul_ps(six, ah3);
+            __m128 ddf = _mm_add_ps(dddf, _mm_mul_ps(two, bh2));
+            for (int i = 0; i <= steps; ++i) {
+                _mm_store_ps(out + i * n + s, f);
+                f = _mm_add_ps(f, df);
+                df = _mm_add_ps(df, ddf);
+                ddf = _mm_add_ps(ddf, dddf);
+            }
+        }
+    }
+#endif
+};
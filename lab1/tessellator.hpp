@@ -0,0 +1,81 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Адаптивное разбиение кубической кривой Безье на отрезки.
+// Кривая делится пополам (алгоритм де Кастельжо), пока внутренние контрольные
+// точки не окажутся ближе tolerance пикселей к отрезку хорды. Прямые участки получают
+// мало вершин, крутые изгибы - много.
+class CurveTessellator {
+public:
+    explicit CurveTessellator(float tolerance = 0.25f, sf::Color color = sf::Color::White, int maxDepth = 16)
+        : tolerance(tolerance), color(color), maxDepth(maxDepth) {}
+
+    // Помечает кривую как изменившуюся
+    void invalidate() { dirty = true; }
+    bool isDirty() const { return dirty; }
+
+    void setTolerance(float value) {
+        if (value != tolerance) {
+            tolerance = value;
+            dirty = true;
+        }
+    }
+
+    // Возвращает закэшированную ломаную, перестраивая её только после invalidate()
+    const std::vector<sf::Vertex>& getVertices(sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3) {
+        if (dirty) {
+            vertices.clear();
+            vertices.emplace_back(p0, color);
+            subdivide(p0, p1, p2, p3, 0);
+            dirty = false;
+        }
+        return vertices;
+    }
+
+private:
+    float tolerance;
+    sf::Color color;
+    int maxDepth;
+    bool dirty = true;
+    std::vector<sf::Vertex> vertices;
+
+    static float lengthSquared(sf::Vector2f v) { return v.x * v.x + v.y * v.y; }
+
+    // Квадрат расстояния от p до отрезка a-b (проекция ограничена концами отрезка)
+    static float segmentDistanceSquared(sf::Vector2f p, sf::Vector2f a, sf::Vector2f b) {
+        sf::Vector2f ab = b - a;
+        float length2 = lengthSquared(ab);
+        float t = 0.0f;
+        if (length2 > 1e-12f)
+            t = std::min(1.0f, std::max(0.0f, ((p.x - a.x) * ab.x + (p.y - a.y) * ab.y) / length2));
+        return lengthSquared(p - (a + ab * t));
+    }
+
+    // Проверка плоскости: расстояние от p1 и p2 до отрезка p0-p3 не больше tolerance.
+    // Расстояние до бесконечной прямой пропустило бы контрольные точки на продолжении
+    // хорды (петля или возврат вдоль неё), и такой участок схлопнулся бы в хорду.
+    // Кривая лежит в выпуклой оболочке точек, поэтому отклонение от отрезка не больше tolerance.
+    bool isFlat(sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3) const {
+        float tolerance2 = tolerance * tolerance;
+        return segmentDistanceSquared(p1, p0, p3) <= tolerance2 && segmentDistanceSquared(p2, p0, p3) <= tolerance2;
+    }
+
+    void subdivide(sf::Vector2f p0, sf::Vector2f p1, sf::Vector2f p2, sf::Vector2f p3, int depth) {
+        if (depth >= maxDepth || isFlat(p0, p1, p2, p3)) {
+            vertices.emplace_back(p3, color);
+            return;
+        }
+        // Деление пополам по де Кастельжо
+        sf::Vector2f p01 = (p0 + p1) * 0.5f;
+        sf::Vector2f p12 = (p1 + p2) * 0.5f;
+        sf::Vector2f p23 = (p2 + p3) * 0.5f;
+        sf::Vector2f p012 = (p01 + p12) * 0.5f;
+        sf::Vector2f p123 = (p12 + p23) * 0.5f;
+        sf::Vector2f mid = (p012 + p123) * 0.5f;
+        subdivide(p0, p01, p012, mid, depth + 1);
+        subdivide(mid, p123, p23, p3, depth + 1);
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+#define GL_GLEXT_PROTOTYPES
+#include <SFML/OpenGL.hpp>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "../common/gl_utils.hpp"
+
+// Вершина куба для буферов: позиция, цвет, нормаль
+struct CubeVertex {
+    GLfloat position[3];
+    GLfloat color[3];
+    GLfloat normal[3];
+};
+
+// Параметры экземпляра: смещение и углы поворота вокруг X и Y в градусах
+struct CubeInstance {
+    GLfloat offset[3];
+    GLfloat angleX;
+    GLfloat angleY;
+};
+
+constexpr int cubeFaceVertexCount = 24;
+constexpr int cubeNormalVertexCount = 12;
+
+// Та же геометрия, что и в drawCube(): 6 граней (GL_QUADS) и 6 линий нормалей (GL_LINES)
+inline std::vector<CubeVertex> buildCubeVertices() {
+    struct Face {
+        GLfloat color[3];
+        GLfloat normal[3];
+        GLfloat corners[4][3];
+    };
+    const Face faces[6] = {
+        {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}}},
+        {{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {{-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}, {1, -1, -1}}},
+        {{0.0f, 0.0f, 1.0f}, {-1.0f, 0.0f, 0.0f}, {{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}}},
+        {{1.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {{1, -1, -1}, {1, 1, -1}, {1, 1, 1}, {1, -1, 1}}},
+        {{1.0f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {{-1, 1, -1}, {-1, 1, 1}, {1, 1, 1}, {1, 1, -1}}},
+        {{0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}}},
+    };
+    const float normalLength = 1.5f;
+
+    std::vector<CubeVertex> vertices;
+    vertices.reserve(cubeFaceVertexCount + cubeNormalVertexCount);
+    for (const Face& face : faces) {
+        for (const auto& corner : face.corners) {
+            vertices.push_back({{corner[0], corner[1], corner[2]},
+                                {face.color[0], face.color[1], face.color[2]},
+                                {face.normal[0], face.normal[1], face.normal[2]}});
+        }
+    }
+    for (const Face& face : faces) {
+        const GLfloat* n = face.normal;
+        vertices.push_back({{n[0], n[1], n[2]}, {1.0f, 1.0f, 1.0f}, {n[0], n[1], n[2]}});
+        vertices.push_back({{n[0] * (1 + normalLength), n[1] * (1 + normalLength), n[2] * (1 + normalLength)},
+                            {1.0f, 1.0f, 1.0f}, {n[0], n[1], n[2]}});
+    }
+    return vertices;
+}
+
+// Кубы из VBO: геометрия загружается один раз, на экземпляр - свои матрица и два вызова отрисовки
+class RetainedCubeRenderer {
+public:
+    RetainedCubeRenderer() {
+        std::vector<CubeVertex> vertices = buildCubeVertices();
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(CubeVertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~RetainedCubeRenderer() { glDeleteBuffers(1, &vbo); }
+
+    RetainedCubeRenderer(const RetainedCubeRenderer&) = delete;
+    RetainedCubeRenderer& operator=(const RetainedCubeRenderer&) = delete;
+
+    void draw(const std::vector<CubeInstance>& instances) const {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(CubeVertex), (void*)offsetof(CubeVertex, position));
+        glColorPointer(3, GL_FLOAT, sizeof(CubeVertex), (void*)offsetof(CubeVertex, color));
+        glNormalPointer(GL_FLOAT, sizeof(CubeVertex), (void*)offsetof(CubeVertex, normal));
+        glLineWidth(2);
+
+        for (const CubeInstance& instance : instances) {
+            glPushMatrix();
+            glTranslatef(instance.offset[0], instance.offset[1], instance.offset[2]);
+            glRotatef(instance.angleX, 1.0f, 0.0f, 0.0f);
+            glRotatef(instance.angleY, 0.0f, 1.0f, 0.0f);
+            glDrawArrays(GL_QUADS, 0, cubeFaceVertexCount);
+            glDrawArrays(GL_LINES, cubeFaceVertexCount, cubeNormalVertexCount);
+            glPopMatrix();
+        }
+
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    GLuint vbo = 0;
+};
+
+// Инстансинг: параметры всех кубов лежат в отдельном буфере с делителем 1,
+// поворот строится в вершинном шейдере, на все кубы - два вызова отрисовки
+class InstancedCubeRenderer {
+public:
+    // Требуется OpenGL 3.3 (или ARB_instanced_arrays + ARB_draw_instanced)
+    static bool isSupported() {
+        return glVersionAtLeast(3, 3) || (hasExtension("GL_ARB_instanced_arrays") && hasExtension("GL_ARB_draw_instanced"));
+    }
+
+    InstancedCubeRenderer() {
+        std::vector<CubeVertex> vertices = buildCubeVertices();
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(CubeVertex), vertices.data(), GL_STATIC_DRAW);
+        glGenBuffers(1, &instanceVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        program = createProgram();
+    }
+
+    ~InstancedCubeRenderer() {
+        glDeleteProgram(program);
+        glDeleteBuffers(1, &instanceVbo);
+        glDeleteBuffers(1, &vbo);
+    }
+
+    InstancedCubeRenderer(const InstancedCubeRenderer&) = delete;
+    InstancedCubeRenderer& operator=(const InstancedCubeRenderer&) = delete;
+
+    // Загрузка параметров экземпляров; буфер пересоздаётся только при росте
+    void update(const std::vector<CubeInstance>& instances) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        std::size_t size = instances.size() * sizeof(CubeInstance);
+        if (size > capacity) {
+            glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_DYNAMIC_DRAW);
+            capacity = size;
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        instanceCount = static_cast<GLsizei>(instances.size());
+    }
+
+    void draw() const {
+        if (instanceCount == 0)
+            return;
+        glUseProgram(program);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(CubeVertex), (void*)offsetof(CubeVertex, position));
+        glColorPointer(3, GL_FLOAT, sizeof(CubeVertex), (void*)offsetof(CubeVertex, color));
+
+        // Смещение и углы экземпляра: attribute vec4 (x, y, z, angleX) и attribute float angleY
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        for (GLuint location : instanceLocations) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttribPointer(instanceLocations[0], 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, offset));
+        glVertexAttribPointer(instanceLocations[1], 1, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, angleY));
+
+        glLineWidth(2);
+        glDrawArraysInstanced(GL_QUADS, 0, cubeFaceVertexCount, instanceCount);
+        glDrawArraysInstanced(GL_LINES, cubeFaceVertexCount, cubeNormalVertexCount, instanceCount);
+
+        for (GLuint location : instanceLocations) {
+            glVertexAttribDivisor(location, 0);
+            glDisableVertexAttribArray(location);
+        }
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+    }
+
+private:
+    // Слоты атрибутов экземпляра. В профиле совместимости NVIDIA встроенные
+    // атрибуты совпадают с общими (0 - gl_Vertex, 2 - gl_Normal, 3 - gl_Color,
+    // 8..15 - gl_MultiTexCoord), поэтому заняты только свободные 1 и 6
+    static constexpr GLuint instanceLocations[2] = {1, 6};
+
+    GLuint vbo = 0;
+    GLuint instanceVbo = 0;
+    GLuint program = 0;
+    std::size_t capacity = 0;
+    GLsizei instanceCount = 0;
+
+    static GLuint createProgram() {
+        // Повороты как у glRotatef(angleX, X) * glRotatef(angleY, Y), углы в градусах
+        const char* vertexSource = R"(
+#version 120
+attribute vec4 instanceData;
+attribute float instanceAngleY;
+
+void main() {
+    vec2 a = radians(vec2(instanceData.w, instanceAngleY));
+    vec2 c = cos(a);
+    vec2 s = sin(a);
+    mat3 rotateX = mat3(1.0, 0.0, 0.0,  0.0, c.x, s.x,  0.0, -s.x, c.x);
+    mat3 rotateY = mat3(c.y, 0.0, -s.y,  0.0, 1.0, 0.0,  s.y, 0.0, c.y);
+    vec3 position = rotateX * (rotateY * gl_Vertex.xyz) + instanceData.xyz;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+    gl_FrontColor = gl_Color;
+}
+)";
+        const char* fragmentSource = R"(
+#version 120
+void main() {
+    gl_FragColor = gl_Color;
+}
+)";
+        return linkProgram(vertexSource, fragmentSource,
+                           {{instanceLocations[0], "instanceData"}, {instanceLocations[1], "instanceAngleY"}});
+    }
+};
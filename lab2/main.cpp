@@ -1,9 +1,18 @@
 #include <SFML/Window.hpp>
-#include <SFML/OpenGL.hpp>
+#include "cube_renderer.hpp"
+#include "../common/soft_raster.hpp"
 #include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
 #include <GL/glu.h>
 
-// g++ -std=c++11 main.cpp -lsfml-window -lsfml-system -lGL -lGLU
+// g++ -std=c++17 -O2 -march=native -pthread main.cpp -lsfml-window -lsfml-system -lGL -lGLU
+// ./a.out --bench - время кадра для 1, 1k, 100k кубов в каждом режиме отрисовки
+// ./a.out --soft out.ppm [N] - N кубов программным растеризатором, без окна
+// M - переключение режима: immediate / VBO / instanced
 
 void drawCube() {
     // Рисуем грани куба
@@ -95,7 +104,112 @@ void drawCube() {
     glEnd();
 }
 
-int main() {
+enum class RenderMode { Immediate, Retained, Instanced };
+
+const char* renderModeName(RenderMode mode) {
+    switch (mode) {
+        case RenderMode::Immediate: return "immediate";
+        case RenderMode::Retained: return "VBO";
+        default: return "instanced";
+    }
+}
+
+// Кубы на квадратной сетке вокруг начала координат
+std::vector<CubeInstance> makeInstances(std::size_t count, float angleX, float angleY) {
+    std::vector<CubeInstance> instances(count);
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    for (std::size_t i = 0; i < count; ++i) {
+        float x = (static_cast<int>(i % side) - (side - 1) / 2.0f) * 4.0f;
+        float z = (static_cast<int>(i / side) - (side - 1) / 2.0f) * 4.0f;
+        instances[i] = {{x, 0.0f, z}, angleX, angleY};
+    }
+    return instances;
+}
+
+void drawInstances(RenderMode mode, const std::vector<CubeInstance>& instances,
+                   const RetainedCubeRenderer& retained, InstancedCubeRenderer* instanced) {
+    if (mode == RenderMode::Immediate) {
+        for (const CubeInstance& instance : instances) {
+            glPushMatrix();
+            glTranslatef(instance.offset[0], instance.offset[1], instance.offset[2]);
+            glRotatef(instance.angleX, 1.0f, 0.0f, 0.0f);
+            glRotatef(instance.angleY, 0.0f, 1.0f, 0.0f);
+            drawCube();
+            glPopMatrix();
+        }
+    } else if (mode == RenderMode::Retained) {
+        retained.draw(instances);
+    } else if (instanced) {
+        instanced->update(instances);
+        instanced->draw();
+    }
+}
+
+void runBenchmark(sf::Window& window, const RetainedCubeRenderer& retained, InstancedCubeRenderer* instanced) {
+    const int frames = 30;
+    const RenderMode modes[] = {RenderMode::Immediate, RenderMode::Retained, RenderMode::Instanced};
+    for (std::size_t count : {std::size_t(1), std::size_t(1000), std::size_t(100000)}) {
+        for (RenderMode mode : modes) {
+            if (mode == RenderMode::Instanced && !instanced)
+                continue;
+            // Сетка строится до замера: время кадра - только отрисовка
+            const std::vector<CubeInstance> instances = makeInstances(count, 30.0f, 30.0f);
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; ++frame) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glLoadIdentity();
+                gluLookAt(5.0f, 5.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+                drawInstances(mode, instances, retained, instanced);
+                window.display();
+                glFinish();
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "cubes: " << count << ", " << renderModeName(mode) << ": "
+                      << elapsed.count() / frames << " ms/frame" << std::endl;
+        }
+    }
+}
+
+// Тот же кадр, что и в окне, программным растеризатором; линии нормалей не рисуются
+void renderSoftware(const std::string& path, std::size_t count) {
+    std::vector<CubeVertex> cube = buildCubeVertices();
+    std::vector<SoftVertex> triangles;
+    for (int face = 0; face < cubeFaceVertexCount; face += 4) {
+        for (int corner : {0, 1, 2, 0, 2, 3}) {
+            const CubeVertex& v = cube[face + corner];
+            triangles.push_back({v.position[0], v.position[1], v.position[2], v.color[0], v.color[1], v.color[2]});
+        }
+    }
+
+    JobSystem jobs;
+    SoftRasterizer rasterizer(800, 600, jobs);
+    const Mat4 viewProjection = perspective(45.0f, 800.0f / 600.0f, 0.01f, 100.0f)
+                              * lookAt({5.0f, 5.0f, 5.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+    const std::vector<CubeInstance> instances = makeInstances(count, 0.0f, 0.0f);
+
+    const int frames = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        for (const CubeInstance& instance : instances) {
+            Mat4 model = translation(instance.offset[0], instance.offset[1], instance.offset[2])
+                       * rotation(instance.angleX, 1.0f, 0.0f, 0.0f) * rotation(instance.angleY, 0.0f, 1.0f, 0.0f);
+            rasterizer.draw(triangles, viewProjection * model);
+        }
+        rasterizer.flush();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "cubes: " << count << ", software, " << jobs.getThreadCount() << " thread(s): "
+              << elapsed.count() / frames << " ms/frame" << std::endl;
+    if (!rasterizer.savePpm(path))
+        std::cerr << "Failed to write " << path << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string(argv[1]) == "--soft") {
+        renderSoftware(argv[2], argc > 3 ? std::stoul(argv[3]) : 1);
+        return EXIT_SUCCESS;
+    }
+
     sf::Window window(sf::VideoMode(800, 600), "lab2", sf::Style::Close | sf::Style::Titlebar);
 
     window.setActive();
@@ -106,6 +220,19 @@ int main() {
     gluPerspective(45.f, (float)800 / (float)600, 0.01f, 100.f);
     glMatrixMode(GL_MODELVIEW);
 
+    // Геометрия загружается в буферы один раз
+    RetainedCubeRenderer retained;
+    std::unique_ptr<InstancedCubeRenderer> instanced;
+    if (InstancedCubeRenderer::isSupported())
+        instanced.reset(new InstancedCubeRenderer());
+
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        window.setVerticalSyncEnabled(false);
+        runBenchmark(window, retained, instanced.get());
+        return EXIT_SUCCESS;
+    }
+
+    RenderMode mode = RenderMode::Immediate;
     float angleX = 0.0f;
     float angleY = 0.0f;
 
@@ -114,6 +241,10 @@ int main() {
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed)
                 window.close();
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::M) {
+                mode = static_cast<RenderMode>((static_cast<int>(mode) + 1) % (instanced ? 3 : 2));
+                window.setTitle(std::string("lab2 - ") + renderModeName(mode));
+            }
         }
 
         // Управление вращением куба
@@ -128,10 +259,7 @@ int main() {
         gluLookAt(5.0f, 5.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
 
         // Вращение куба
-        glRotatef(angleX, 1.0f, 0.0f, 0.0f);
-        glRotatef(angleY, 0.0f, 1.0f, 0.0f);
-
-        drawCube();
+        drawInstances(mode, {{{0.0f, 0.0f, 0.0f}, angleX, angleY}}, retained, instanced.get());
 
         window.display();
     }
@@ -0,0 +1,298 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "../common/math.hpp"
+#include "../common/job_system.hpp"
+
+struct Aabb {
+    Vec3 min, max;
+
+    bool contains(const Aabb& o) const {
+        return min.x <= o.min.x && min.y <= o.min.y && min.z <= o.min.z
+            && max.x >= o.max.x && max.y >= o.max.y && max.z >= o.max.z;
+    }
+    bool containsPoint(Vec3 p, float margin = 0) const {
+        return p.x >= min.x - margin && p.y >= min.y - margin && p.z >= min.z - margin
+            && p.x <= max.x + margin && p.y <= max.y + margin && p.z <= max.z + margin;
+    }
+    float surfaceArea() const {
+        Vec3 d = max - min;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    static Aabb merge(const Aabb& a, const Aabb& b) {
+        return {{std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)},
+                {std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z)}};
+    }
+};
+
+// Мировой AABB для локального куба [-1, 1]^3 (куб и пирамида в него вписаны)
+inline Aabb worldBounds(const Mat4& world) {
+    Vec3 center = {world.at(0, 3), world.at(1, 3), world.at(2, 3)};
+    Vec3 extent = {std::abs(world.at(0, 0)) + std::abs(world.at(0, 1)) + std::abs(world.at(0, 2)),
+                   std::abs(world.at(1, 0)) + std::abs(world.at(1, 1)) + std::abs(world.at(1, 2)),
+                   std::abs(world.at(2, 0)) + std::abs(world.at(2, 1)) + std::abs(world.at(2, 2))};
+    return {center - extent, center + extent};
+}
+
+// Шесть плоскостей пирамиды видимости, извлечённых из projection * view
+// (метод Грибба-Хартманна). Нормали направлены внутрь.
+struct Frustum {
+    float planes[6][4];
+
+    explicit Frustum(const Mat4& viewProjection) {
+        for (int i = 0; i < 3; ++i) {
+            for (int sign = 0; sign < 2; ++sign) {
+                float* plane = planes[i * 2 + sign];
+                for (int c = 0; c < 4; ++c) {
+                    float row = viewProjection.at(i, c);
+                    plane[c] = viewProjection.at(3, c) + (sign ? -row : row);
+                }
+                float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                for (int c = 0; c < 4; ++c)
+                    plane[c] /= length;
+            }
+        }
+    }
+
+    enum Result { Outside, Intersects, Inside };
+
+    Result test(const Aabb& box) const {
+        Result result = Inside;
+        for (const float* p : planes) {
+            // Самая дальняя и самая ближняя вдоль нормали вершины
+            float far = p[0] * (p[0] > 0 ? box.max.x : box.min.x) + p[1] * (p[1] > 0 ? box.max.y : box.min.y)
+                      + p[2] * (p[2] > 0 ? box.max.z : box.min.z) + p[3];
+            if (far < 0)
+                return Outside;
+            float near = p[0] * (p[0] > 0 ? box.min.x : box.max.x) + p[1] * (p[1] > 0 ? box.min.y : box.max.y)
+                       + p[2] * (p[2] > 0 ? box.min.z : box.max.z) + p[3];
+            if (near < 0)
+                result = Intersects;
+        }
+        return result;
+    }
+};
+
+// Динамическая иерархия AABB. Листья хранят "раздутые" на margin прямоугольники,
+// поэтому небольшие сдвиги объектов не трогают дерево. При выходе за пределы
+// лист переставляется; место вставки выбирается по приросту площади поверхности.
+class DynamicBvh {
+public:
+    explicit DynamicBvh(float margin = 0.5f) : margin(margin) {}
+
+    int insert(const Aabb& box, int userData) {
+        int leaf = allocateNode();
+        nodes[leaf].box = fatten(box);
+        nodes[leaf].userData = userData;
+        insertLeaf(leaf);
+        return leaf;
+    }
+
+    void remove(int leaf) {
+        removeLeaf(leaf);
+        freeNode(leaf);
+    }
+
+    // Возвращает true, если лист пришлось переставить
+    bool update(int leaf, const Aabb& box) {
+        if (nodes[leaf].box.contains(box))
+            return false;
+        removeLeaf(leaf);
+        nodes[leaf].box = fatten(box);
+        insertLeaf(leaf);
+        return true;
+    }
+
+    // Сбор userData всех листьев, пересекающих пирамиду видимости.
+    // Поддеревья, целиком лежащие внутри, добавляются без проверок.
+    void query(const Frustum& frustum, std::vector<int>& result) const {
+        if (root < 0)
+            return;
+        stack.clear();
+        stack.push_back({root, false});
+        traverse(frustum, stack, result);
+    }
+
+    // То же параллельно: верхние уровни раскрываются в ширину до набора
+    // независимых поддеревьев, которые обходятся задачами пула
+    void query(const Frustum& frustum, std::vector<int>& result, JobSystem& jobs) const {
+        if (root < 0)
+            return;
+        frontier.assign(1, {root, false});
+        const std::size_t target = jobs.getThreadCount() * 8;
+        for (std::size_t i = 0; i < frontier.size() && frontier.size() < target; ) {
+            Entry entry = frontier[i];
+            const Node& node = nodes[entry.node];
+            bool inside = entry.inside;
+            if (!inside) {
+                Frustum::Result r = frustum.test(node.box);
+                if (r == Frustum::Outside) {
+                    frontier[i] = frontier.back();
+                    frontier.pop_back();
+                    continue;
+                }
+                inside = r == Frustum::Inside;
+            }
+            if (node.isLeaf()) {
+                ++i;
+                continue;
+            }
+            // Проверенный узел заменяется детьми; inside уже учтён
+            frontier[i] = {node.left, inside};
+            frontier.push_back({node.right, inside});
+        }
+
+        partialResults.resize(frontier.size());
+        jobs.parallelFor(frontier.size(), 1, [&](std::size_t begin, std::size_t end) {
+            std::vector<Entry> localStack;
+            for (std::size_t i = begin; i < end; ++i) {
+                partialResults[i].clear();
+                localStack.assign(1, frontier[i]);
+                traverse(frustum, localStack, partialResults[i]);
+            }
+        });
+        for (const std::vector<int>& partial : partialResults)
+            result.insert(result.end(), partial.begin(), partial.end());
+    }
+
+private:
+    struct Node {
+        Aabb box;
+        int parent = -1;
+        int left = -1, right = -1;
+        int userData = -1;
+        bool isLeaf() const { return left < 0; }
+    };
+    struct Entry {
+        int node;
+        bool inside;
+    };
+
+    float margin;
+    int root = -1;
+    int freeList = -1;
+    std::vector<Node> nodes;
+    mutable std::vector<Entry> stack;
+    mutable std::vector<Entry> frontier;
+    mutable std::vector<std::vector<int>> partialResults;
+
+    void traverse(const Frustum& frustum, std::vector<Entry>& pending, std::vector<int>& result) const {
+        while (!pending.empty()) {
+            Entry entry = pending.back();
+            pending.pop_back();
+            const Node& node = nodes[entry.node];
+            bool inside = entry.inside;
+            if (!inside) {
+                Frustum::Result r = frustum.test(node.box);
+                if (r == Frustum::Outside)
+                    continue;
+                inside = r == Frustum::Inside;
+            }
+            if (node.isLeaf()) {
+                result.push_back(node.userData);
+            } else {
+                pending.push_back({node.left, inside});
+                pending.push_back({node.right, inside});
+            }
+        }
+    }
+
+    Aabb fatten(const Aabb& box) const {
+        Vec3 m = {margin, margin, margin};
+        return {box.min - m, box.max + m};
+    }
+
+    int allocateNode() {
+        if (freeList >= 0) {
+            int node = freeList;
+            freeList = nodes[node].parent;
+            nodes[node] = Node();
+            return node;
+        }
+        nodes.emplace_back();
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    void freeNode(int node) {
+        nodes[node].parent = freeList;
+        freeList = node;
+    }
+
+    void insertLeaf(int leaf) {
+        if (root < 0) {
+            root = leaf;
+            nodes[leaf].parent = -1;
+            return;
+        }
+
+        // Спуск к соседу с наименьшей стоимостью (прирост площади поверхности)
+        const Aabb box = nodes[leaf].box;
+        int index = root;
+        while (!nodes[index].isLeaf()) {
+            const Node& node = nodes[index];
+            float area = node.box.surfaceArea();
+            float combinedArea = Aabb::merge(node.box, box).surfaceArea();
+            float cost = 2 * combinedArea;
+            float inheritance = 2 * (combinedArea - area);
+            auto childCost = [&](int child) {
+                float merged = Aabb::merge(box, nodes[child].box).surfaceArea();
+                return nodes[child].isLeaf() ? merged + inheritance
+                                             : merged - nodes[child].box.surfaceArea() + inheritance;
+            };
+            float leftCost = childCost(node.left);
+            float rightCost = childCost(node.right);
+            if (cost < leftCost && cost < rightCost)
+                break;
+            index = leftCost < rightCost ? node.left : node.right;
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = Aabb::merge(box, nodes[sibling].box);
+        nodes[newParent].left = sibling;
+        nodes[newParent].right = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent < 0) {
+            root = newParent;
+        } else if (nodes[oldParent].left == sibling) {
+            nodes[oldParent].left = newParent;
+        } else {
+            nodes[oldParent].right = newParent;
+        }
+        refitUp(newParent);
+    }
+
+    void removeLeaf(int leaf) {
+        if (leaf == root) {
+            root = -1;
+            return;
+        }
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+        if (grandParent < 0) {
+            root = sibling;
+            nodes[sibling].parent = -1;
+        } else {
+            if (nodes[grandParent].left == parent) {
+                nodes[grandParent].left = sibling;
+            } else {
+                nodes[grandParent].right = sibling;
+            }
+            nodes[sibling].parent = grandParent;
+            refitUp(grandParent);
+        }
+        freeNode(parent);
+    }
+
+    void refitUp(int index) {
+        for (; index >= 0; index = nodes[index].parent) {
+            Node& node = nodes[index];
+            node.box = Aabb::merge(nodes[node.left].box, nodes[node.right].box);
+        }
+    }
+};
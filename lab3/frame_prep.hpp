@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "scene_graph.hpp"
+#include "culling.hpp"
+#include "mesh_batch.hpp"
+#include "../common/job_system.hpp"
+
+// Время стадий кадра в миллисекундах
+struct StageTimings {
+    double transforms = 0;
+    double bounds = 0;
+    double culling = 0;
+    double drawList = 0;
+    double submit = 0;
+};
+
+struct DrawItem {
+    int node;
+    Mesh mesh;
+    Mat4 world;
+};
+
+// Всё, что нужно главному потоку для отправки кадра в GL. Кадр не ссылается
+// на граф сцены, поэтому следующий кадр можно готовить во время отправки.
+struct FrameData {
+    Mat4 view;
+    std::size_t nodeCount = 0;
+    std::size_t meshCount = 0;
+    // Мировые матрицы узлов [firstMatrix, firstMatrix + matrices.size() / 16)
+    std::size_t firstMatrix = 0;
+    std::vector<float> matrices;
+    std::vector<DrawItem> drawList;
+    std::vector<DrawElementsCommand> commands;
+    StageTimings timings;
+};
+
+// Подготовка кадра в пуле потоков: мировые матрицы, уточнение BVH,
+// отсечение по пирамиде видимости и сборка списка отрисовки
+class FramePreparer {
+public:
+    FramePreparer(SceneGraph& scene, JobSystem& jobs) : scene(scene), jobs(jobs) {}
+
+    // Если задан, в кадр дописываются команды для glMultiDrawElementsIndirect
+    void setMeshBatch(const MeshBatch* batch) { meshBatch = batch; }
+
+    void prepare(FrameData& frame, const Mat4& projection, const Mat4& view) {
+        using Clock = std::chrono::steady_clock;
+        auto elapsed = [](Clock::time_point since) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+        };
+
+        auto start = Clock::now();
+        const std::vector<int>& updated = scene.update(&jobs);
+        // При росте сцены буфер матриц пересоздаётся, поэтому нужен полный диапазон
+        std::size_t first = 0, last = 0;
+        if (scene.size() != uploadedCount) {
+            last = scene.size();
+        } else if (!updated.empty()) {
+            auto range = std::minmax_element(updated.begin(), updated.end());
+            first = *range.first;
+            last = *range.second + 1;
+        }
+        uploadedCount = scene.size();
+        frame.nodeCount = scene.size();
+        frame.meshCount = scene.getMeshNodes().size();
+        frame.firstMatrix = first;
+        frame.matrices.assign(scene.getWorldData() + first * 16, scene.getWorldData() + last * 16);
+        frame.timings.transforms = elapsed(start);
+
+        // Рамки считаются параллельно, а общее дерево уточняется последовательно;
+        // листья, оставшиеся внутри своих расширенных рамок, дерево не трогают
+        start = Clock::now();
+        bounds.resize(updated.size());
+        jobs.parallelFor(updated.size(), 4096, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                bounds[i] = worldBounds(scene.getWorld(updated[i]));
+        });
+        bvhLeaf.resize(scene.size(), -1);
+        for (std::size_t i = 0; i < updated.size(); ++i) {
+            int node = updated[i];
+            if (scene.getMesh(node) == Mesh::None)
+                continue;
+            if (bvhLeaf[node] < 0) {
+                bvhLeaf[node] = bvh.insert(bounds[i], node);
+            } else {
+                bvh.update(bvhLeaf[node], bounds[i]);
+            }
+        }
+        frame.timings.bounds = elapsed(start);
+
+        start = Clock::now();
+        frame.view = view;
+        visible.clear();
+        bvh.query(Frustum(projection * view), visible, jobs);
+        frame.timings.culling = elapsed(start);
+
+        // Список отрисовки от ближних к дальним: раньше заполняется буфер глубины,
+        // и от этого порядка зависят запросы перекрытия
+        start = Clock::now();
+        depthOrder.resize(visible.size());
+        jobs.parallelFor(visible.size(), 4096, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const Mat4& world = scene.getWorld(visible[i]);
+                float depth = -(view.at(2, 0) * world.at(0, 3) + view.at(2, 1) * world.at(1, 3)
+                              + view.at(2, 2) * world.at(2, 3) + view.at(2, 3));
+                depthOrder[i] = {depth, visible[i]};
+            }
+        });
+        std::sort(depthOrder.begin(), depthOrder.end());
+        frame.drawList.resize(visible.size());
+        frame.commands.resize(meshBatch ? visible.size() : 0);
+        jobs.parallelFor(visible.size(), 2048, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                int node = depthOrder[i].second;
+                frame.drawList[i] = {node, scene.getMesh(node), scene.getWorld(node)};
+                if (meshBatch)
+                    frame.commands[i] = meshBatch->getCommand(node, frame.drawList[i].mesh);
+            }
+        });
+        frame.timings.drawList = elapsed(start);
+    }
+
+private:
+    SceneGraph& scene;
+    JobSystem& jobs;
+    const MeshBatch* meshBatch = nullptr;
+    DynamicBvh bvh;
+    std::vector<int> bvhLeaf;
+    std::vector<Aabb> bounds;
+    std::vector<int> visible;
+    std::vector<std::pair<float, int>> depthOrder;
+    std::size_t uploadedCount = 0;
+};
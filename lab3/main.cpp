@@ -1,23 +1,46 @@
 #include <SFML/Window.hpp>
-#include <SFML/OpenGL.hpp>
+#include "frame_prep.hpp"
+#include "occlusion.hpp"
 #include <GL/glu.h>
+#include <algorithm>
 #include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <memory>
+#include <string>
+#include <iostream>
+#include "scene_graph.hpp"
+#include "culling.hpp"
+#include "transform_soa.hpp"
+#include "../common/job_system.hpp"
+#include "../common/soft_raster.hpp"
+#include "meshes.hpp"
+
+// g++ -std=c++17 -O2 -march=native -pthread main.cpp -lsfml-window -lsfml-system -lGL -lGLU
+// ./a.out --bench - обновление сцены из 100k узлов при правке нескольких узлов за кадр
+// ./a.out --bench-transforms - построение матриц, скаляр против SIMD, 1k..1M объектов
+// ./a.out --bench-frame - стадии подготовки кадра в одном потоке и в пуле потоков
+// ./a.out --scene N - добавить N случайных объектов для проверки отсечения
+// ./a.out --soft out.ppm [N] - та же сцена программным растеризатором, без окна
+// M - переключение между glMultiDrawElementsIndirect и отрисовкой по объектам
+// C - включение запросов перекрытия
 
 // Параметры камеры
 float cameraX = 0.0f, cameraY = 0.0f, cameraZ = 5.0f;
 float cameraAngleX = 0.0f, cameraAngleY = 0.0f;
 
-// Текущий объект и его трансформации
+// Текущий объект (индекс в objects) и граф сцены
 int currentObject = 0;
-constexpr int numObjects = 2;
-struct Transform {
-    float posX, posY, posZ;
-    float scaleX, scaleY, scaleZ;
-    float rotX, rotY, rotZ;
-} transforms[numObjects] = {
-    { -1.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f },
-    {  1.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f }
-};
+SceneGraph scene;
+std::vector<int> objects;
+
+// Весь видимый набор одним вызовом glMultiDrawElementsIndirect
+bool useIndirect = true;
+// Пропуск объектов, закрытых другими (по результатам запросов прошлых кадров)
+bool useOcclusion = true;
+std::vector<DrawItem> unoccludedItems;
+std::vector<DrawElementsCommand> unoccludedCommands;
 
 void drawCube() {
     glBegin(GL_QUADS);
@@ -83,15 +106,267 @@ void drawPyramid() {
     glEnd();
 }
 
-void applyTransform(const Transform& transform) {
-    glTranslatef(transform.posX, transform.posY, transform.posZ);
-    glRotatef(transform.rotX, 1.0f, 0.0f, 0.0f);
-    glRotatef(transform.rotY, 0.0f, 1.0f, 0.0f);
-    glRotatef(transform.rotZ, 0.0f, 0.0f, 1.0f);
-    glScalef(transform.scaleX, transform.scaleY, transform.scaleZ);
+Mat4 cameraView() {
+    Vec3 eye = {cameraX, cameraY, cameraZ};
+    Vec3 target = {cameraX + std::sin(cameraAngleY), cameraY + std::sin(cameraAngleX), cameraZ - std::cos(cameraAngleY)};
+    return lookAt(eye, target, {0.0f, 1.0f, 0.0f});
+}
+
+void drawMesh(Mesh mesh) {
+    if (mesh == Mesh::Cube) {
+        drawCube();
+    } else if (mesh == Mesh::Pyramid) {
+        drawPyramid();
+    }
+}
+
+// Сцена из groups групп по children узлов; за кадр меняется edits узлов
+void runBenchmark(int groups, int children, int edits) {
+    SceneGraph graph;
+    int root = graph.createNode(-1, identityTransform);
+    std::vector<int> nodes;
+    for (int g = 0; g < groups; ++g) {
+        Transform groupTransform = identityTransform;
+        groupTransform.posX = static_cast<float>(g % 100) * 3.0f;
+        groupTransform.posZ = static_cast<float>(g / 100) * 3.0f;
+        int group = graph.createNode(root, groupTransform);
+        nodes.push_back(group);
+        for (int c = 0; c < children; ++c) {
+            Transform childTransform = identityTransform;
+            childTransform.posY = static_cast<float>(c) * 0.5f;
+            nodes.push_back(graph.createNode(group, childTransform, c % 2 ? Mesh::Pyramid : Mesh::Cube));
+        }
+    }
+    graph.update();
+
+    const int frames = 100;
+    std::mt19937 rng(1);
+    auto start = std::chrono::steady_clock::now();
+    std::size_t updatedNodes = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int e = 0; e < edits; ++e) {
+            int node = nodes[rng() % nodes.size()];
+            Transform t = graph.getLocal(node);
+            t.rotY += 5.0f;
+            graph.setLocal(node, t);
+        }
+        updatedNodes += graph.update().size();
+    }
+    std::chrono::duration<double, std::milli> partial = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        Transform t = graph.getLocal(root);
+        t.rotY += 5.0f;
+        graph.setLocal(root, t);
+        graph.update();
+    }
+    std::chrono::duration<double, std::milli> full = std::chrono::steady_clock::now() - start;
+
+    std::cout << "nodes: " << graph.size() << ", edits per frame: " << edits << std::endl;
+    std::cout << "incremental update: " << partial.count() / frames << " ms/frame ("
+              << updatedNodes / frames << " nodes recomputed)" << std::endl;
+    std::cout << "full update: " << full.count() / frames << " ms/frame" << std::endl;
+}
+
+// Матриц в секунду: локальные T * R * S из структуры массивов и произведение с родителем
+void runTransformBenchmark() {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(0.0f, 360.0f), scale(0.5f, 2.0f);
+    std::cout << "SIMD: " << TransformArray::simdName() << std::endl;
+    for (std::size_t count : {1000u, 10000u, 100000u, 1000000u}) {
+        TransformArray transforms;
+        for (std::size_t i = 0; i < count; ++i) {
+            transforms.add({position(rng), position(rng), position(rng)}, fromEuler(angle(rng), angle(rng), angle(rng)),
+                           {scale(rng), scale(rng), scale(rng)});
+        }
+        std::vector<float> scalarOut(count * 16), simdOut(count * 16), worlds(count * 16);
+        Mat4 parent = translation(1.0f, 2.0f, 3.0f) * rotation(30.0f, 0.0f, 1.0f, 0.0f);
+        const int repeats = static_cast<int>(std::max<std::size_t>(1, 4000000 / count));
+
+        auto measure = [&](auto&& body) {
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; ++r)
+                body();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return static_cast<double>(count) * repeats / elapsed.count();
+        };
+        double scalarBuild = measure([&] { transforms.buildMatricesScalar(scalarOut.data()); });
+        double simdBuild = measure([&] { transforms.buildMatrices(simdOut.data()); });
+        double scalarCompose = measure([&] {
+            for (std::size_t i = 0; i < count; ++i) {
+                Mat4 local;
+                std::copy(&scalarOut[i * 16], &scalarOut[i * 16] + 16, local.m);
+                Mat4 world = parent * local;
+                std::copy(world.m, world.m + 16, &worlds[i * 16]);
+            }
+        });
+        double simdCompose = measure([&] {
+            for (std::size_t i = 0; i < count; ++i)
+                multiplyMatrices(parent.m, &simdOut[i * 16], &worlds[i * 16]);
+        });
+
+        float maxDiff = 0;
+        for (std::size_t i = 0; i < scalarOut.size(); ++i)
+            maxDiff = std::max(maxDiff, std::abs(scalarOut[i] - simdOut[i]));
+        std::cout << count << " objects: build " << scalarBuild / 1e6 << " -> " << simdBuild / 1e6
+                  << " M/s, compose " << scalarCompose / 1e6 << " -> " << simdCompose / 1e6
+                  << " M/s (max diff " << maxDiff << ")" << std::endl;
+    }
+}
+
+// Сцена из count вращающихся объектов: каждый кадр пересчитываются все матрицы
+void runFrameBenchmark(int count) {
+    SceneGraph graph;
+    int root = graph.createNode(-1, identityTransform);
+    std::vector<int> nodes;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(0.0f, 360.0f);
+    for (int i = 0; i < count; ++i) {
+        Transform t = {position(rng), position(rng) / 5, position(rng), 0.3f, 0.3f, 0.3f, angle(rng), angle(rng), 0.0f};
+        nodes.push_back(graph.createNode(root, t, i % 2 ? Mesh::Pyramid : Mesh::Cube));
+    }
+    const Mat4 projection = perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+    const Mat4 view = lookAt({0.0f, 0.0f, 5.0f}, {0.0f, 0.0f, 4.0f}, {0.0f, 1.0f, 0.0f});
+
+    std::vector<unsigned> workerCounts = {0};
+    if (JobSystem::defaultWorkerCount() > 0)
+        workerCounts.push_back(JobSystem::defaultWorkerCount());
+    for (unsigned workers : workerCounts) {
+        JobSystem jobs(workers);
+        FramePreparer preparer(graph, jobs);
+        FrameData frame;
+        preparer.prepare(frame, projection, view);
+        const int frames = 50;
+        StageTimings total;
+        for (int f = 0; f < frames; ++f) {
+            for (int node : nodes) {
+                Transform t = graph.getLocal(node);
+                t.rotY += 1.0f;
+                graph.setLocal(node, t);
+            }
+            preparer.prepare(frame, projection, view);
+            total.transforms += frame.timings.transforms;
+            total.bounds += frame.timings.bounds;
+            total.culling += frame.timings.culling;
+            total.drawList += frame.timings.drawList;
+        }
+        std::cout << jobs.getThreadCount() << " thread(s): transforms " << total.transforms / frames
+                  << " ms, bvh " << total.bounds / frames << " ms, culling " << total.culling / frames
+                  << " ms, draw list " << total.drawList / frames << " ms (" << frame.drawList.size()
+                  << " visible of " << count << ")" << std::endl;
+    }
+}
+
+// Куб и пирамида - обычные узлы с геометрией под общим корнем, плюс
+// randomObjects случайных объектов для проверки отсечения
+void buildScene(int randomObjects) {
+    int root = scene.createNode(-1, identityTransform);
+    objects.push_back(scene.createNode(root, { -1.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f }, Mesh::Cube));
+    objects.push_back(scene.createNode(root, {  1.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f }, Mesh::Pyramid));
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(0.0f, 360.0f);
+    for (int i = 0; i < randomObjects; ++i) {
+        Transform t = {position(rng), position(rng) / 5, position(rng), 0.3f, 0.3f, 0.3f, angle(rng), angle(rng), 0.0f};
+        objects.push_back(scene.createNode(root, t, i % 2 ? Mesh::Pyramid : Mesh::Cube));
+    }
 }
 
-int main() {
+// Кадр без OpenGL: те же окно 1280x1080, проекция, камера и белые меши на
+// фоне glClearColor. Печатает время кадра и сохраняет изображение.
+void renderSoftware(const std::string& path) {
+    std::vector<SoftVertex> meshTriangles[3];
+    for (Mesh mesh : {Mesh::Cube, Mesh::Pyramid}) {
+        std::vector<float> vertices;
+        std::vector<unsigned> indices;
+        appendMesh(mesh, vertices, indices);
+        for (unsigned index : indices)
+            meshTriangles[static_cast<int>(mesh)].push_back({vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2], 1.0f, 1.0f, 1.0f});
+    }
+
+    JobSystem jobs;
+    SoftRasterizer rasterizer(1280, 1080, jobs);
+    rasterizer.setClearColor(0.1f, 0.1f, 0.1f);
+    scene.update(&jobs);
+    const Mat4 viewProjection = perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f) * cameraView();
+
+    const int frames = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int node : scene.getMeshNodes())
+            rasterizer.draw(meshTriangles[static_cast<int>(scene.getMesh(node))], viewProjection * scene.getWorld(node));
+        rasterizer.flush();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << scene.getMeshNodes().size() << " objects, " << jobs.getThreadCount() << " thread(s): "
+              << elapsed.count() / frames << " ms/frame" << std::endl;
+    if (!rasterizer.savePpm(path))
+        std::cerr << "Failed to write " << path << std::endl;
+}
+
+// Отправка готового кадра; граф сцены здесь не читается
+void submitFrame(const FrameData& frame, MatrixBuffer* matrixBuffer, MeshBatch* meshBatch, OcclusionCuller* occlusion) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(frame.view.m);
+
+    if (matrixBuffer)
+        matrixBuffer->upload(frame.nodeCount, frame.firstMatrix, frame.matrices);
+    const std::vector<DrawItem>* drawList = &frame.drawList;
+    const std::vector<DrawElementsCommand>* commands = &frame.commands;
+    if (occlusion) {
+        occlusion->filter(frame, unoccludedItems, unoccludedCommands);
+        drawList = &unoccludedItems;
+        commands = &unoccludedCommands;
+    }
+
+    // Сразу после переключения M у кадра может ещё не быть команд
+    if (meshBatch && useIndirect && commands->size() == drawList->size()) {
+        meshBatch->submit(*commands, frame.nodeCount, *matrixBuffer);
+    } else if (matrixBuffer) {
+        matrixBuffer->begin();
+        for (const DrawItem& item : *drawList) {
+            matrixBuffer->setObject(item.node);
+            drawMesh(item.mesh);
+        }
+        matrixBuffer->end();
+    } else {
+        for (const DrawItem& item : *drawList) {
+            glPushMatrix();
+            glMultMatrixf(item.world.m);
+            drawMesh(item.mesh);
+            glPopMatrix();
+        }
+    }
+
+    // Буфер глубины уже заполнен видимыми объектами - проверка рамок всех остальных
+    if (occlusion)
+        occlusion->issueQueries(frame, matrixBuffer);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runBenchmark(1000, 100, 10);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-transforms") {
+        runTransformBenchmark();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-frame") {
+        runFrameBenchmark(100000);
+        return 0;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--soft") {
+        buildScene(argc > 3 ? std::stoi(argv[3]) : 0);
+        renderSoftware(argv[2]);
+        return 0;
+    }
+
+    buildScene(argc > 2 && std::string(argv[1]) == "--scene" ? std::stoi(argv[2]) : 0);
+    const Mat4 projection = perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+
     sf::Window window(sf::VideoMode(1280, 1080), "lab3", sf::Style::Default, sf::ContextSettings(32));
     window.setVerticalSyncEnabled(true);
 
@@ -101,6 +376,26 @@ int main() {
     glLoadIdentity();
     gluPerspective(45.0, 4.0/3.0, 0.1, 100.0);
 
+    // Без текстурных буферов остаётся путь через стек матриц
+    std::unique_ptr<MatrixBuffer> matrixBuffer;
+    std::unique_ptr<MeshBatch> meshBatch;
+    if (MatrixBuffer::isSupported()) {
+        matrixBuffer = std::make_unique<MatrixBuffer>();
+        if (MeshBatch::isSupported())
+            meshBatch = std::make_unique<MeshBatch>();
+    }
+
+    OcclusionCuller occlusion;
+
+    // Пока главный поток отправляет кадр N, пул готовит кадр N + 1
+    JobSystem jobs;
+    FramePreparer preparer(scene, jobs);
+    preparer.setMeshBatch(useIndirect ? meshBatch.get() : nullptr);
+    FrameData frames[2];
+    int current = 0;
+    preparer.prepare(frames[current], projection, cameraView());
+    int frameCounter = 0;
+
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -116,47 +411,62 @@ int main() {
                 if (event.key.code == sf::Keyboard::A) cameraX -= 0.1f;
                 if (event.key.code == sf::Keyboard::D) cameraX += 0.1f;
                 // Переключение между объектами
-                if (event.key.code == sf::Keyboard::Tab) currentObject = (currentObject + 1) % numObjects;
+                if (event.key.code == sf::Keyboard::Tab) currentObject = (currentObject + 1) % static_cast<int>(objects.size());
+                if (event.key.code == sf::Keyboard::M) {
+                    useIndirect = !useIndirect;
+                    preparer.setMeshBatch(useIndirect ? meshBatch.get() : nullptr);
+                }
+                if (event.key.code == sf::Keyboard::C) useOcclusion = !useOcclusion;
                 // Трансформации текущего объекта
-                if (event.key.code == sf::Keyboard::Q) transforms[currentObject].posX -= 0.1f;
-                if (event.key.code == sf::Keyboard::E) transforms[currentObject].posX += 0.1f;
-                if (event.key.code == sf::Keyboard::R) transforms[currentObject].posY += 0.1f;
-                if (event.key.code == sf::Keyboard::F) transforms[currentObject].posY -= 0.1f;
-                if (event.key.code == sf::Keyboard::T) transforms[currentObject].posZ += 0.1f;
-                if (event.key.code == sf::Keyboard::G) transforms[currentObject].posZ -= 0.1f;
-                if (event.key.code == sf::Keyboard::Up) transforms[currentObject].rotX += 5.0f;
-                if (event.key.code == sf::Keyboard::Down) transforms[currentObject].rotX -= 5.0f;
-                if (event.key.code == sf::Keyboard::Left) transforms[currentObject].rotY += 5.0f;
-                if (event.key.code == sf::Keyboard::Right) transforms[currentObject].rotY -= 5.0f;
-                if (event.key.code == sf::Keyboard::O) transforms[currentObject].rotZ += 5.0f;
-                if (event.key.code == sf::Keyboard::L) transforms[currentObject].rotZ -= 5.0f;
-                if (event.key.code == sf::Keyboard::Y) transforms[currentObject].scaleX += 0.1f;
-                if (event.key.code == sf::Keyboard::H) transforms[currentObject].scaleX -= 0.1f;
-                if (event.key.code == sf::Keyboard::U) transforms[currentObject].scaleY += 0.1f;
-                if (event.key.code == sf::Keyboard::J) transforms[currentObject].scaleY -= 0.1f;
-                if (event.key.code == sf::Keyboard::I) transforms[currentObject].scaleZ += 0.1f;
-                if (event.key.code == sf::Keyboard::K) transforms[currentObject].scaleZ -= 0.1f;
+                Transform transform = scene.getLocal(objects[currentObject]);
+                if (event.key.code == sf::Keyboard::Q) transform.posX -= 0.1f;
+                if (event.key.code == sf::Keyboard::E) transform.posX += 0.1f;
+                if (event.key.code == sf::Keyboard::R) transform.posY += 0.1f;
+                if (event.key.code == sf::Keyboard::F) transform.posY -= 0.1f;
+                if (event.key.code == sf::Keyboard::T) transform.posZ += 0.1f;
+                if (event.key.code == sf::Keyboard::G) transform.posZ -= 0.1f;
+                if (event.key.code == sf::Keyboard::Up) transform.rotX += 5.0f;
+                if (event.key.code == sf::Keyboard::Down) transform.rotX -= 5.0f;
+                if (event.key.code == sf::Keyboard::Left) transform.rotY += 5.0f;
+                if (event.key.code == sf::Keyboard::Right) transform.rotY -= 5.0f;
+                if (event.key.code == sf::Keyboard::O) transform.rotZ += 5.0f;
+                if (event.key.code == sf::Keyboard::L) transform.rotZ -= 5.0f;
+                if (event.key.code == sf::Keyboard::Y) transform.scaleX += 0.1f;
+                if (event.key.code == sf::Keyboard::H) transform.scaleX -= 0.1f;
+                if (event.key.code == sf::Keyboard::U) transform.scaleY += 0.1f;
+                if (event.key.code == sf::Keyboard::J) transform.scaleY -= 0.1f;
+                if (event.key.code == sf::Keyboard::I) transform.scaleZ += 0.1f;
+                if (event.key.code == sf::Keyboard::K) transform.scaleZ -= 0.1f;
+                scene.setLocal(objects[currentObject], transform);
             }
         }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Подготовка следующего кадра идёт в пуле, пока этот отправляется в GL.
+        // Изменения из обработки событий попадают в следующий кадр.
+        FrameData& next = frames[1 - current];
+        JobSystem::Counter preparing;
+        Mat4 nextView = cameraView();
+        jobs.run(preparing, [&] { preparer.prepare(next, projection, nextView); });
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        gluLookAt(cameraX, cameraY, cameraZ, cameraX + sin(cameraAngleY), cameraY + sin(cameraAngleX), cameraZ - cos(cameraAngleY), 0.0f, 1.0f, 0.0f);
+        auto submitStart = std::chrono::steady_clock::now();
+        FrameData& frame = frames[current];
+        submitFrame(frame, matrixBuffer.get(), meshBatch.get(), useOcclusion ? &occlusion : nullptr);
+        frame.timings.submit = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
 
-        for (int i = 0; i < numObjects; ++i) {
-            glPushMatrix();
-            applyTransform(transforms[i]);
-            if (i == 0) {
-                drawCube();
-            } else if (i == 1) {
-                drawPyramid();
-            }
-            glPopMatrix();
+        if (++frameCounter % 30 == 0) {
+            const StageTimings& t = frame.timings;
+            char timings[160];
+            std::snprintf(timings, sizeof(timings), " | transforms %.2f, bvh %.2f, culling %.2f, draw list %.2f, submit %.2f ms",
+                          t.transforms, t.bounds, t.culling, t.drawList, t.submit);
+            std::size_t occluded = useOcclusion ? occlusion.getOccludedCount() : 0;
+            window.setTitle("lab3 - visible: " + std::to_string(frame.drawList.size() - occluded) + ", culled: "
+                            + std::to_string(frame.meshCount - frame.drawList.size()) + ", occluded: " + std::to_string(occluded)
+                            + (meshBatch && useIndirect ? " (indirect)" : "") + timings);
         }
 
         window.display();
+        jobs.wait(preparing);
+        current = 1 - current;
     }
 
     return 0;
@@ -0,0 +1,105 @@
+#pragma once
+#define GL_GLEXT_PROTOTYPES
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "../common/gl_utils.hpp"
+#include "scene_graph.hpp"
+
+// Мировые матрицы всех узлов в текстурном буфере (RGBA32F, 4 texel на матрицу).
+// Изменённый за кадр диапазон загружается одним glBufferSubData,
+// а при отрисовке вместо glPushMatrix/glMultMatrixf/glPopMatrix задаётся только
+// индекс узла - матрицу вершинный шейдер читает сам.
+class MatrixBuffer {
+public:
+    // Требуется OpenGL 3.1 (или ARB_texture_buffer_object) и EXT_gpu_shader4
+    static bool isSupported() {
+        return hasExtension("GL_EXT_gpu_shader4") && (glVersionAtLeast(3, 1) || hasExtension("GL_ARB_texture_buffer_object"));
+    }
+
+    MatrixBuffer() {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        program = createProgram();
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "worldMatrices"), 0);
+        objectIndexLocation = glGetUniformLocation(program, "objectIndex");
+        glUseProgram(0);
+    }
+
+    ~MatrixBuffer() {
+        glDeleteProgram(program);
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    MatrixBuffer(const MatrixBuffer&) = delete;
+    MatrixBuffer& operator=(const MatrixBuffer&) = delete;
+
+    // matrices - мировые матрицы узлов начиная с first, по 16 чисел.
+    // При росте числа узлов буфер пересоздаётся, и диапазон должен быть полным.
+    void upload(std::size_t nodeCount, std::size_t first, const std::vector<float>& matrices) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (nodeCount > capacity) {
+            capacity = std::max<std::size_t>(nodeCount, capacity * 2);
+            glBufferData(GL_TEXTURE_BUFFER, capacity * 16 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        if (!matrices.empty())
+            glBufferSubData(GL_TEXTURE_BUFFER, first * 16 * sizeof(float), matrices.size() * sizeof(float), matrices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Между begin() и end() объекты рисуются как обычно, перед каждым - setObject()
+    void begin() const {
+        glUseProgram(program);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    void setObject(int node) const { glUniform1i(objectIndexLocation, node); }
+
+    GLuint getTexture() const { return texture; }
+
+    void end() const {
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glUseProgram(0);
+    }
+
+private:
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    GLuint program = 0;
+    GLint objectIndexLocation = -1;
+    std::size_t capacity = 0;
+
+    static GLuint createProgram() {
+        // В GL_MODELVIEW остаётся только камера (gluLookAt)
+        const char* vertexSource = R"(
+#version 120
+#extension GL_EXT_gpu_shader4 : require
+uniform samplerBuffer worldMatrices;
+uniform int objectIndex;
+
+void main() {
+    int base = objectIndex * 4;
+    mat4 world = mat4(texelFetchBuffer(worldMatrices, base),
+                      texelFetchBuffer(worldMatrices, base + 1),
+                      texelFetchBuffer(worldMatrices, base + 2),
+                      texelFetchBuffer(worldMatrices, base + 3));
+    gl_Position = gl_ModelViewProjectionMatrix * (world * gl_Vertex);
+    gl_FrontColor = gl_Color;
+}
+)";
+        const char* fragmentSource = R"(
+#version 120
+void main() {
+    gl_FragColor = gl_Color;
+}
+)";
+        return linkProgram(vertexSource, fragmentSource);
+    }
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include "matrix_buffer.hpp"
+#include <cstddef>
+#include <vector>
+#include "scene_graph.hpp"
+#include "meshes.hpp"
+
+// Команда glMultiDrawElementsIndirect (раскладка задана спецификацией)
+struct DrawElementsCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Статический пакет: геометрия всех мешей в общем VBO/IBO, на кадр - буфер
+// команд по одной на видимый узел и один вызов glMultiDrawElementsIndirect.
+// Команды собираются заранее (getCommand), submit() только загружает их.
+// baseInstance команды равен индексу узла: атрибут objectIndex с делителем 1
+// читается из буфера 0, 1, 2, ..., поэтому шейдер получает номер узла и берёт
+// его мировую матрицу из текстурного буфера MatrixBuffer.
+class MeshBatch {
+public:
+    // Требуется OpenGL 4.3 (или ARB_multi_draw_indirect + ARB_base_instance)
+    static bool isSupported() {
+        return glVersionAtLeast(4, 3) || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance"));
+    }
+
+    MeshBatch() {
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint> indices;
+        addMesh(Mesh::Cube, vertices, indices);
+        addMesh(Mesh::Pyramid, vertices, indices);
+
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        glGenBuffers(1, &ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glGenBuffers(1, &objectIndexVbo);
+        glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        program = createProgram();
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "worldMatrices"), 0);
+        glUseProgram(0);
+    }
+
+    ~MeshBatch() {
+        glDeleteProgram(program);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &objectIndexVbo);
+        glDeleteBuffers(1, &ibo);
+        glDeleteBuffers(1, &vbo);
+    }
+
+    MeshBatch(const MeshBatch&) = delete;
+    MeshBatch& operator=(const MeshBatch&) = delete;
+
+    // Команда для узла; GL не используется, можно вызывать из любого потока
+    DrawElementsCommand getCommand(int node, Mesh mesh) const {
+        const Range& range = ranges[static_cast<int>(mesh)];
+        return {range.count, 1, range.firstIndex, 0, static_cast<GLuint>(node)};
+    }
+
+    // objectCount - число узлов сцены; матрицы уже загружены в matrices
+    void submit(const std::vector<DrawElementsCommand>& commands, std::size_t objectCount, const MatrixBuffer& matrices) {
+        if (commands.empty())
+            return;
+        reserveObjects(objectCount);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        std::size_t size = commands.size() * sizeof(DrawElementsCommand);
+        if (size > commandCapacity) {
+            commandCapacity = size * 2;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCapacity, nullptr, GL_STREAM_DRAW);
+        }
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, commands.data());
+
+        glUseProgram(program);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, matrices.getTexture());
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 3 * sizeof(GLfloat), nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, objectIndexVbo);
+        glEnableVertexAttribArray(objectIndexAttribute);
+        glVertexAttribPointer(objectIndexAttribute, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), nullptr);
+        glVertexAttribDivisor(objectIndexAttribute, 1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commands.size()), 0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glVertexAttribDivisor(objectIndexAttribute, 0);
+        glDisableVertexAttribArray(objectIndexAttribute);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glUseProgram(0);
+    }
+
+private:
+    struct Range {
+        GLuint firstIndex = 0;
+        GLuint count = 0;
+    };
+
+    static constexpr GLuint objectIndexAttribute = 1;
+
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    GLuint objectIndexVbo = 0;
+    GLuint commandBuffer = 0;
+    GLuint program = 0;
+    Range ranges[3];
+    std::size_t objectCapacity = 0;
+    std::size_t commandCapacity = 0;
+
+    // Буфер 0, 1, 2, ... по числу узлов сцены; растёт только вместе со сценой
+    void reserveObjects(std::size_t count) {
+        if (count <= objectCapacity)
+            return;
+        objectCapacity = count * 2;
+        std::vector<GLfloat> objectIndices(objectCapacity);
+        for (std::size_t i = 0; i < objectCapacity; ++i)
+            objectIndices[i] = static_cast<GLfloat>(i);
+        glBindBuffer(GL_ARRAY_BUFFER, objectIndexVbo);
+        glBufferData(GL_ARRAY_BUFFER, objectIndices.size() * sizeof(GLfloat), objectIndices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void addMesh(Mesh mesh, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices) {
+        Range& range = ranges[static_cast<int>(mesh)];
+        range.firstIndex = static_cast<GLuint>(indices.size());
+        appendMesh(mesh, vertices, indices);
+        range.count = static_cast<GLuint>(indices.size()) - range.firstIndex;
+    }
+
+    static GLuint createProgram() {
+        const char* vertexSource = R"(
+#version 120
+#extension GL_EXT_gpu_shader4 : require
+uniform samplerBuffer worldMatrices;
+attribute float objectIndex;
+
+void main() {
+    int base = int(objectIndex) * 4;
+    mat4 world = mat4(texelFetchBuffer(worldMatrices, base),
+                      texelFetchBuffer(worldMatrices, base + 1),
+                      texelFetchBuffer(worldMatrices, base + 2),
+                      texelFetchBuffer(worldMatrices, base + 3));
+    gl_Position = gl_ModelViewProjectionMatrix * (world * gl_Vertex);
+    gl_FrontColor = gl_Color;
+}
+)";
+        const char* fragmentSource = R"(
+#version 120
+void main() {
+    gl_FragColor = gl_Color;
+}
+)";
+        return linkProgram(vertexSource, fragmentSource, {{objectIndexAttribute, "objectIndex"}});
+    }
+};
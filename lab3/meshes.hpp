@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "scene_graph.hpp"
+
+// Та же геометрия, что и в drawCube()/drawPyramid(), в виде индексированных
+// треугольников: позиции по 3 числа, четырёхугольники делятся на два треугольника.
+// Общая для пакетной отрисовки (MeshBatch) и программного растеризатора.
+inline void appendMesh(Mesh mesh, std::vector<float>& vertices, std::vector<unsigned>& indices) {
+    static const float cube[6][4][3] = {
+        {{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}},
+        {{-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}, {1, -1, -1}},
+        {{-1, 1, -1}, {-1, 1, 1}, {1, 1, 1}, {1, 1, -1}},
+        {{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}},
+        {{1, -1, -1}, {1, 1, -1}, {1, 1, 1}, {1, -1, 1}},
+        {{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}},
+    };
+    static const float pyramidSides[4][3][3] = {
+        {{0, 1, 0}, {-1, -1, 1}, {1, -1, 1}},
+        {{0, 1, 0}, {1, -1, 1}, {1, -1, -1}},
+        {{0, 1, 0}, {1, -1, -1}, {-1, -1, -1}},
+        {{0, 1, 0}, {-1, -1, -1}, {-1, -1, 1}},
+    };
+    static const float pyramidBase[4][3] = {{-1, -1, 1}, {1, -1, 1}, {1, -1, -1}, {-1, -1, -1}};
+
+    auto addVertex = [&](const float* v) {
+        vertices.insert(vertices.end(), v, v + 3);
+        return static_cast<unsigned>(vertices.size() / 3 - 1);
+    };
+    auto addQuad = [&](const float (*quad)[3]) {
+        unsigned a = addVertex(quad[0]), b = addVertex(quad[1]), c = addVertex(quad[2]), d = addVertex(quad[3]);
+        indices.insert(indices.end(), {a, b, c, a, c, d});
+    };
+    if (mesh == Mesh::Cube) {
+        for (const auto& face : cube)
+            addQuad(face);
+    } else if (mesh == Mesh::Pyramid) {
+        for (const auto& side : pyramidSides) {
+            for (const auto& v : side)
+                indices.push_back(addVertex(v));
+        }
+        addQuad(pyramidBase);
+    }
+}
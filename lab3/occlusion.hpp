@@ -0,0 +1,186 @@
+#pragma once
+#include "matrix_buffer.hpp"
+#include <cstddef>
+#include <vector>
+#include "frame_prep.hpp"
+
+// Отсечение невидимых объектов аппаратными запросами перекрытия.
+// Видимость кадра берётся из уже готовых результатов прошлых кадров:
+// сначала рисуются объекты, видимые в прошлый раз (список отсортирован от
+// ближних к дальним, так что они заполняют буфер глубины), затем для
+// объектов выдаются запросы по их ограничивающим рамкам. Результат
+// читается только когда GL_QUERY_RESULT_AVAILABLE, поэтому процессор никогда
+// не ждёт видеокарту; пока запрос не готов, используется прежний ответ.
+// Ставшие видимыми объекты появляются с задержкой в кадр.
+// Отдельного прохода только по глубине нет: перекрывающие объекты - это
+// просто видимые, нарисованные от ближних к дальним.
+//
+// Рамка совпадает с геометрией куба, который сам уже записал глубину, и при
+// GL_LESS её фрагменты проваливали бы тест о собственный объект. Поэтому
+// рамка чуть раздута, а запросы идут с GL_LEQUAL и сдвигом полигонов к камере.
+class OcclusionCuller {
+public:
+    OcclusionCuller() {
+        if (glVersionAtLeast(3, 3))
+            target = GL_ANY_SAMPLES_PASSED;
+
+        // Рамка - локальный куб [-1, 1]^3, в который вписаны все меши, с небольшим запасом
+        const GLfloat e = 1.0f + boxInflation;
+        const GLfloat corners[8][3] = {
+            {-e, -e, -e}, {e, -e, -e}, {e, e, -e}, {-e, e, -e},
+            {-e, -e, e}, {e, -e, e}, {e, e, e}, {-e, e, e},
+        };
+        static const int faces[6][4] = {
+            {4, 5, 6, 7}, {1, 0, 3, 2}, {0, 4, 7, 3}, {5, 1, 2, 6}, {7, 6, 2, 3}, {0, 1, 5, 4},
+        };
+        std::vector<GLfloat> vertices;
+        for (const auto& face : faces) {
+            for (int corner : {face[0], face[1], face[2], face[0], face[2], face[3]})
+                vertices.insert(vertices.end(), corners[corner], corners[corner] + 3);
+        }
+        glGenBuffers(1, &boxVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~OcclusionCuller() {
+        for (const NodeState& state : states) {
+            if (state.query)
+                glDeleteQueries(1, &state.query);
+        }
+        glDeleteBuffers(1, &boxVbo);
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Забор готовых результатов и отбор видимых элементов кадра (порядок сохраняется).
+    // commands, если не пуст, фильтруется вместе с drawList.
+    void filter(const FrameData& frame, std::vector<DrawItem>& drawList, std::vector<DrawElementsCommand>& commands) {
+        ++frameIndex;
+        if (states.size() < frame.nodeCount)
+            states.resize(frame.nodeCount);
+        collectResults();
+
+        drawList.clear();
+        commands.clear();
+        occludedCount = 0;
+        for (std::size_t i = 0; i < frame.drawList.size(); ++i) {
+            NodeState& state = states[frame.drawList[i].node];
+            // Объект, которого не было в пирамиде видимости, считается видимым заново
+            if (state.lastFrame + 1 != frameIndex)
+                state.visible = true;
+            state.lastFrame = frameIndex;
+            if (!state.visible) {
+                ++occludedCount;
+                continue;
+            }
+            drawList.push_back(frame.drawList[i]);
+            if (!frame.commands.empty())
+                commands.push_back(frame.commands[i]);
+        }
+    }
+
+    // Запросы по рамкам после отрисовки видимых объектов. Скрытые проверяются
+    // каждый кадр, видимые - раз в несколько кадров вразнобой; объект с
+    // незавершённым запросом не запрашивается повторно.
+    void issueQueries(const FrameData& frame, const MatrixBuffer* matrixBuffer) {
+        Vec3 eye = eyePosition(frame.view);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(-1.0f, -1.0f);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 3 * sizeof(GLfloat), nullptr);
+        if (matrixBuffer)
+            matrixBuffer->begin();
+
+        for (const DrawItem& item : frame.drawList) {
+            NodeState& state = states[item.node];
+            if (state.pending)
+                continue;
+            if (state.visible && (frameIndex + item.node) % visibleQueryInterval != 0)
+                continue;
+            // Камера внутри рамки (с запасом на ближнюю плоскость): грани отсечены, запрос ненадёжен
+            if (worldBounds(item.world).containsPoint(eye, nearMargin)) {
+                state.visible = true;
+                continue;
+            }
+            if (!state.query)
+                glGenQueries(1, &state.query);
+            glBeginQuery(target, state.query);
+            if (matrixBuffer) {
+                matrixBuffer->setObject(item.node);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            } else {
+                glPushMatrix();
+                glMultMatrixf(item.world.m);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glPopMatrix();
+            }
+            glEndQuery(target);
+            state.pending = true;
+            pending.push_back(item.node);
+        }
+
+        if (matrixBuffer)
+            matrixBuffer->end();
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // Сколько объектов из пирамиды видимости пропущено в последнем кадре
+    std::size_t getOccludedCount() const { return occludedCount; }
+
+private:
+    struct NodeState {
+        GLuint query = 0;
+        bool pending = false;
+        bool visible = true;
+        unsigned lastFrame = 0;
+    };
+
+    static constexpr unsigned visibleQueryInterval = 4;
+    static constexpr float nearMargin = 0.2f;
+    static constexpr float boxInflation = 0.01f;
+
+    GLenum target = GL_SAMPLES_PASSED;
+    GLuint boxVbo = 0;
+    std::vector<NodeState> states;
+    std::vector<int> pending;
+    unsigned frameIndex = 0;
+    std::size_t occludedCount = 0;
+
+    void collectResults() {
+        std::size_t kept = 0;
+        for (int node : pending) {
+            NodeState& state = states[node];
+            GLuint available = 0;
+            glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                pending[kept++] = node;
+                continue;
+            }
+            GLuint samples = 0;
+            glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &samples);
+            state.visible = samples > 0;
+            state.pending = false;
+        }
+        pending.resize(kept);
+    }
+
+    // Положение камеры из матрицы вида: -R^T * t
+    static Vec3 eyePosition(const Mat4& view) {
+        Vec3 t = {view.at(0, 3), view.at(1, 3), view.at(2, 3)};
+        return {-(view.at(0, 0) * t.x + view.at(1, 0) * t.y + view.at(2, 0) * t.z),
+                -(view.at(0, 1) * t.x + view.at(1, 1) * t.y + view.at(2, 1) * t.z),
+                -(view.at(0, 2) * t.x + view.at(1, 2) * t.y + view.at(2, 2) * t.z)};
+    }
+};
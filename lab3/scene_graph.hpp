@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "../common/math.hpp"
+#include "transform_soa.hpp"
+#include "../common/job_system.hpp"
+
+// Локальные перемещение, масштаб и поворот (углы Эйлера в градусах)
+struct Transform {
+    float posX, posY, posZ;
+    float scaleX, scaleY, scaleZ;
+    float rotX, rotY, rotZ;
+
+    bool operator==(const Transform& o) const {
+        return posX == o.posX && posY == o.posY && posZ == o.posZ
+            && scaleX == o.scaleX && scaleY == o.scaleY && scaleZ == o.scaleZ
+            && rotX == o.rotX && rotY == o.rotY && rotZ == o.rotZ;
+    }
+    bool operator!=(const Transform& o) const { return !(*this == o); }
+};
+
+const Transform identityTransform = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f};
+
+// getWorldData() отдаёт массив Mat4 как сплошной массив чисел
+static_assert(sizeof(Mat4) == 16 * sizeof(float), "Mat4 must be tightly packed");
+
+enum class Mesh { None, Cube, Pyramid };
+
+// Иерархия узлов с кэшированными мировыми матрицами.
+// Узлы хранятся в плоских массивах, родитель всегда создаётся раньше потомка.
+// Изменение узла помечает его "грязным"; update() пересчитывает только
+// поддеревья изменённых узлов, поэтому стоимость кадра зависит от числа
+// правок, а не от размера сцены. Локальные матрицы строятся пачками из
+// структуры массивов (TransformArray), мировые матрицы лежат подряд и
+// загружаются в буфер одним вызовом.
+class SceneGraph {
+public:
+    int createNode(int parent, const Transform& local, Mesh mesh = Mesh::None) {
+        int node = static_cast<int>(parents.size());
+        parents.push_back(parent);
+        depths.push_back(parent >= 0 ? depths[parent] + 1 : 0);
+        firstChild.push_back(-1);
+        nextSibling.push_back(-1);
+        if (parent >= 0) {
+            nextSibling[node] = firstChild[parent];
+            firstChild[parent] = node;
+        }
+        locals.push_back(local);
+        transforms.add({local.posX, local.posY, local.posZ}, fromEuler(local.rotX, local.rotY, local.rotZ),
+                       {local.scaleX, local.scaleY, local.scaleZ});
+        worlds.emplace_back();
+        meshes.push_back(mesh);
+        dirty.push_back(false);
+        if (mesh != Mesh::None)
+            meshNodes.push_back(node);
+        markDirty(node);
+        return node;
+    }
+
+    std::size_t size() const { return parents.size(); }
+    int getParent(int node) const { return parents[node]; }
+    Mesh getMesh(int node) const { return meshes[node]; }
+    const Transform& getLocal(int node) const { return locals[node]; }
+    const Mat4& getWorld(int node) const { return worlds[node]; }
+    // Мировые матрицы всех узлов подряд, по 16 чисел на узел
+    const float* getWorldData() const { return worlds.empty() ? nullptr : worlds[0].m; }
+    // Узлы с геометрией в порядке создания
+    const std::vector<int>& getMeshNodes() const { return meshNodes; }
+
+    void setLocal(int node, const Transform& local) {
+        if (locals[node] == local)
+            return;
+        locals[node] = local;
+        transforms.set(node, {local.posX, local.posY, local.posZ}, fromEuler(local.rotX, local.rotY, local.rotZ),
+                       {local.scaleX, local.scaleY, local.scaleZ});
+        markDirty(node);
+    }
+
+    // Пересчёт мировых матриц изменённых поддеревьев.
+    // Возвращает узлы, у которых изменилась мировая матрица.
+    // С jobs большие обновления считаются параллельно: локальные матрицы -
+    // пачками, произведения с родителями - по уровням глубины.
+    const std::vector<int>& update(JobSystem* jobs = nullptr) {
+        updated.clear();
+        // Родители имеют меньшие индексы, поэтому после сортировки поддерево
+        // предка обрабатывается раньше, и его потомки уже не считаются грязными
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+        for (int root : dirtyNodes) {
+            if (!dirty[root])
+                continue;
+            stack.push_back(root);
+            while (!stack.empty()) {
+                int node = stack.back();
+                stack.pop_back();
+                dirty[node] = false;
+                updated.push_back(node);
+                for (int child = firstChild[node]; child >= 0; child = nextSibling[child])
+                    stack.push_back(child);
+            }
+        }
+        dirtyNodes.clear();
+
+        // Сначала все локальные матрицы одним проходом SIMD, затем произведения
+        // с родителями. В updated родитель всегда стоит раньше потомка.
+        scratch.resize(updated.size() * 16);
+        if (!jobs || updated.size() < parallelThreshold) {
+            transforms.buildMatrices(updated.data(), updated.size(), scratch.data());
+            for (std::size_t i = 0; i < updated.size(); ++i)
+                composeWorld(i);
+            return updated;
+        }
+
+        jobs->parallelFor(updated.size(), parallelGrain, [this](std::size_t begin, std::size_t end) {
+            transforms.buildMatrices(updated.data() + begin, end - begin, scratch.data() + begin * 16);
+        });
+        // Узлы одного уровня зависят только от предыдущего уровня
+        levelStart.assign(1, 0);
+        for (int node : updated) {
+            std::size_t level = depths[node] + 1;
+            if (levelStart.size() <= level)
+                levelStart.resize(level + 1, 0);
+            ++levelStart[level];
+        }
+        for (std::size_t level = 1; level < levelStart.size(); ++level)
+            levelStart[level] += levelStart[level - 1];
+        levelOrder.resize(updated.size());
+        std::vector<std::size_t> position(levelStart.begin(), levelStart.end() - 1);
+        for (std::size_t i = 0; i < updated.size(); ++i)
+            levelOrder[position[depths[updated[i]]]++] = i;
+        for (std::size_t level = 0; level + 1 < levelStart.size(); ++level) {
+            std::size_t first = levelStart[level];
+            jobs->parallelFor(levelStart[level + 1] - first, parallelGrain, [this, first](std::size_t begin, std::size_t end) {
+                for (std::size_t k = begin; k < end; ++k)
+                    composeWorld(levelOrder[first + k]);
+            });
+        }
+        return updated;
+    }
+
+private:
+    static constexpr std::size_t parallelThreshold = 4096;
+    static constexpr std::size_t parallelGrain = 1024;
+
+    std::vector<int> parents;
+    std::vector<int> depths;
+    std::vector<int> firstChild;
+    std::vector<int> nextSibling;
+    std::vector<Transform> locals;
+    TransformArray transforms;
+    std::vector<float> scratch;
+    std::vector<Mat4> worlds;
+    std::vector<Mesh> meshes;
+    std::vector<char> dirty;
+    std::vector<int> meshNodes;
+    std::vector<int> dirtyNodes;
+    std::vector<int> updated;
+    std::vector<int> stack;
+    std::vector<std::size_t> levelStart;
+    std::vector<std::size_t> levelOrder;
+
+    // i - позиция узла в updated и его локальной матрицы в scratch
+    void composeWorld(std::size_t i) {
+        int node = updated[i];
+        int parent = parents[node];
+        const float* local = &scratch[i * 16];
+        if (parent >= 0) {
+            multiplyMatrices(worlds[parent].m, local, worlds[node].m);
+        } else {
+            std::copy(local, local + 16, worlds[node].m);
+        }
+    }
+
+    void markDirty(int node) {
+        if (!dirty[node]) {
+            dirty[node] = true;
+            dirtyNodes.push_back(node);
+        }
+    }
+};
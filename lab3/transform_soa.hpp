@@ -0,0 +1,257 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "../common/math.hpp"
+
+struct Quat {
+    float w = 1, x = 0, y = 0, z = 0;
+};
+
+inline Quat operator*(Quat a, Quat b) {
+    return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+            a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+inline Quat axisAngle(float degrees, float x, float y, float z) {
+    float half = degrees * 3.14159265358979f / 360.0f;
+    float s = std::sin(half);
+    return {std::cos(half), x * s, y * s, z * s};
+}
+
+// Поворот, эквивалентный glRotatef(rx, X) * glRotatef(ry, Y) * glRotatef(rz, Z)
+inline Quat fromEuler(float rx, float ry, float rz) {
+    return axisAngle(rx, 1, 0, 0) * axisAngle(ry, 0, 1, 0) * axisAngle(rz, 0, 0, 1);
+}
+
+// Перемещения, повороты (кватернионы) и масштабы объектов в виде структуры массивов.
+// Матрицы T * R * S строятся пачками по 4 (SSE) или 8 (AVX) объектов и
+// записываются подряд по 16 чисел (по столбцам), готовыми к загрузке в буфер.
+class TransformArray {
+public:
+    std::size_t add(Vec3 position, Quat rotation, Vec3 scale) {
+        std::size_t index = px.size();
+        px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+        qw.push_back(rotation.w); qx.push_back(rotation.x); qy.push_back(rotation.y); qz.push_back(rotation.z);
+        sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+        return index;
+    }
+
+    void set(std::size_t i, Vec3 position, Quat rotation, Vec3 scale) {
+        px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+        qw[i] = rotation.w; qx[i] = rotation.x; qy[i] = rotation.y; qz[i] = rotation.z;
+        sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+    }
+
+    std::size_t size() const { return px.size(); }
+
+    void buildMatrixScalar(std::size_t i, float* out) const {
+        float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+        out[0] = (1 - 2 * (y * y + z * z)) * sx[i];
+        out[1] = 2 * (x * y + w * z) * sx[i];
+        out[2] = 2 * (x * z - w * y) * sx[i];
+        out[3] = 0;
+        out[4] = 2 * (x * y - w * z) * sy[i];
+        out[5] = (1 - 2 * (x * x + z * z)) * sy[i];
+        out[6] = 2 * (y * z + w * x) * sy[i];
+        out[7] = 0;
+        out[8] = 2 * (x * z + w * y) * sz[i];
+        out[9] = 2 * (y * z - w * x) * sz[i];
+        out[10] = (1 - 2 * (x * x + y * y)) * sz[i];
+        out[11] = 0;
+        out[12] = px[i];
+        out[13] = py[i];
+        out[14] = pz[i];
+        out[15] = 1;
+    }
+
+    // Матрицы для объектов indices[0..count), out[k * 16] - матрица indices[k]
+    void buildMatricesScalar(const int* indices, std::size_t count, float* out) const {
+        for (std::size_t k = 0; k < count; ++k)
+            buildMatrixScalar(indices[k], out + k * 16);
+    }
+
+    void buildMatricesScalar(float* out) const {
+        for (std::size_t i = 0; i < size(); ++i)
+            buildMatrixScalar(i, out + i * 16);
+    }
+
+#if defined(__SSE__) || defined(_M_X64)
+    void buildMatrices(const int* indices, std::size_t count, float* out) const {
+        std::size_t k = 0;
+        for (; k + 4 <= count; k += 4) {
+            const int* id = indices + k;
+            auto gather = [id](const std::vector<float>& v) { return _mm_setr_ps(v[id[0]], v[id[1]], v[id[2]], v[id[3]]); };
+            buildFour(gather(px), gather(py), gather(pz), gather(qw), gather(qx), gather(qy), gather(qz),
+                      gather(sx), gather(sy), gather(sz), out + k * 16);
+        }
+        for (; k < count; ++k)
+            buildMatrixScalar(indices[k], out + k * 16);
+    }
+
+    void buildMatrices(float* out) const {
+        std::size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 8 <= size(); i += 8)
+            buildEight(i, out + i * 16);
+#endif
+        for (; i + 4 <= size(); i += 4) {
+            buildFour(_mm_loadu_ps(&px[i]), _mm_loadu_ps(&py[i]), _mm_loadu_ps(&pz[i]),
+                      _mm_loadu_ps(&qw[i]), _mm_loadu_ps(&qx[i]), _mm_loadu_ps(&qy[i]), _mm_loadu_ps(&qz[i]),
+                      _mm_loadu_ps(&sx[i]), _mm_loadu_ps(&sy[i]), _mm_loadu_ps(&sz[i]), out + i * 16);
+        }
+        for (; i < size(); ++i)
+            buildMatrixScalar(i, out + i * 16);
+    }
+#else
+    void buildMatrices(const int* indices, std::size_t count, float* out) const { buildMatricesScalar(indices, count, out); }
+    void buildMatrices(float* out) const { buildMatricesScalar(out); }
+#endif
+
+    static const char* simdName() {
+#if defined(__AVX__)
+        return "AVX";
+#elif defined(__SSE__) || defined(_M_X64)
+        return "SSE";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    std::vector<float> px, py, pz;
+    std::vector<float> qw, qx, qy, qz;
+    std::vector<float> sx, sy, sz;
+
+#if defined(__SSE__) || defined(_M_X64)
+    // Элементы матриц для четырёх объектов считаются в разных дорожках,
+    // затем каждые четыре столбца транспонируются в построчную запись объектов
+    static void buildFour(__m128 tx, __m128 ty, __m128 tz, __m128 w, __m128 x, __m128 y, __m128 z,
+                          __m128 scaleX, __m128 scaleY, __m128 scaleZ, float* out) {
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 columns[4][4];
+        columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+        columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+        columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+        columns[0][3] = _mm_setzero_ps();
+        columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+        columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+        columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+        columns[1][3] = _mm_setzero_ps();
+        columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+        columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+        columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+        columns[2][3] = _mm_setzero_ps();
+        columns[3][0] = tx;
+        columns[3][1] = ty;
+        columns[3][2] = tz;
+        columns[3][3] = one;
+
+        for (int c = 0; c < 4; ++c) {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (int object = 0; object < 4; ++object)
+                _mm_storeu_ps(out + object * 16 + c * 4, columns[c][object]);
+        }
+    }
+#endif
+
+#if defined(__AVX__)
+    void buildEight(std::size_t i, float* out) const {
+        const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+        __m256 x = _mm256_loadu_ps(&qx[i]), y = _mm256_loadu_ps(&qy[i]), z = _mm256_loadu_ps(&qz[i]), w = _mm256_loadu_ps(&qw[i]);
+        __m256 scaleX = _mm256_loadu_ps(&sx[i]), scaleY = _mm256_loadu_ps(&sy[i]), scaleZ = _mm256_loadu_ps(&sz[i]);
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        __m256 elements[16];
+        elements[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), scaleX);
+        elements[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), scaleX);
+        elements[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), scaleX);
+        elements[3] = _mm256_setzero_ps();
+        elements[4] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), scaleY);
+        elements[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), scaleY);
+        elements[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), scaleY);
+        elements[7] = _mm256_setzero_ps();
+        elements[8] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), scaleZ);
+        elements[9] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), scaleZ);
+        elements[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), scaleZ);
+        elements[11] = _mm256_setzero_ps();
+        elements[12] = _mm256_loadu_ps(&px[i]);
+        elements[13] = _mm256_loadu_ps(&py[i]);
+        elements[14] = _mm256_loadu_ps(&pz[i]);
+        elements[15] = one;
+
+        // Две половины по 4 объекта транспонируются так же, как в buildFour
+        for (int half = 0; half < 2; ++half) {
+            for (int c = 0; c < 4; ++c) {
+                __m128 r0 = half ? _mm256_extractf128_ps(elements[c * 4 + 0], 1) : _mm256_castps256_ps128(elements[c * 4 + 0]);
+                __m128 r1 = half ? _mm256_extractf128_ps(elements[c * 4 + 1], 1) : _mm256_castps256_ps128(elements[c * 4 + 1]);
+                __m128 r2 = half ? _mm256_extractf128_ps(elements[c * 4 + 2], 1) : _mm256_castps256_ps128(elements[c * 4 + 2]);
+                __m128 r3 = half ? _mm256_extractf128_ps(elements[c * 4 + 3], 1) : _mm256_castps256_ps128(elements[c * 4 + 3]);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                float* base = out + half * 64 + c * 4;
+                _mm_storeu_ps(base, r0);
+                _mm_storeu_ps(base + 16, r1);
+                _mm_storeu_ps(base + 32, r2);
+                _mm_storeu_ps(base + 48, r3);
+            }
+        }
+    }
+#endif
+};
+
+// Произведение матриц 4x4 по столбцам: out = a * b (out может совпадать с b).
+// Столбец результата - сумма столбцов a с весами из столбца b; в AVX-версии
+// две 128-битные половины регистра считают два столбца сразу
+inline void multiplyMatrices(const float* a, const float* b, float* out) {
+#if defined(__AVX__)
+    // Столбец a в обеих половинах; входы не обязаны быть выровнены
+    auto duplicate = [](const float* column) {
+        __m128 half = _mm_loadu_ps(column);
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(half), half, 1);
+    };
+    __m256 a0 = duplicate(a), a1 = duplicate(a + 4), a2 = duplicate(a + 8), a3 = duplicate(a + 12);
+    // Оба столбца b загружаются до записи, так что out == b допустимо
+    __m256 b01 = _mm256_loadu_ps(b), b23 = _mm256_loadu_ps(b + 8);
+    __m256 columns[2];
+    for (int pair = 0; pair < 2; ++pair) {
+        __m256 weights = pair ? b23 : b01;
+        columns[pair] = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(weights, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(weights, 0x55))),
+            _mm256_add_ps(_mm256_mul_ps(a2, _mm256_permute_ps(weights, 0xAA)), _mm256_mul_ps(a3, _mm256_permute_ps(weights, 0xFF))));
+    }
+    _mm256_storeu_ps(out, columns[0]);
+    _mm256_storeu_ps(out + 8, columns[1]);
+#elif defined(__SSE__) || defined(_M_X64)
+    __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    __m128 columns[4];
+    for (int c = 0; c < 4; ++c) {
+        columns[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[c * 4 + 0])), _mm_mul_ps(a1, _mm_set1_ps(b[c * 4 + 1]))),
+                                _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[c * 4 + 2])), _mm_mul_ps(a3, _mm_set1_ps(b[c * 4 + 3]))));
+    }
+    for (int c = 0; c < 4; ++c)
+        _mm_storeu_ps(out + c * 4, columns[c]);
+#else
+    Mat4 ma, mb;
+    for (int i = 0; i < 16; ++i) {
+        ma.m[i] = a[i];
+        mb.m[i] = b[i];
+    }
+    Mat4 result = ma * mb;
+    for (int i = 0; i < 16; ++i)
+        out[i] = result.m[i];
+#endif
+}
@@ -0,0 +1,46 @@
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <string>
+#include "texture_container.hpp"
+
+// Офлайн-подготовка текстур lab4: декодирование, мип-цепочка и сжатие
+// в контейнер .tex, который main.cpp отображает в память при запуске.
+// g++ -std=c++17 -O2 bake_textures.cpp -o bake_textures -lsfml-graphics -lsfml-system
+// ./bake_textures 2.jpg 2.tex --bc1 && ./bake_textures 3.jpg 3.tex --bc5
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: bake_textures input output [--rgba|--bc1|--bc5]" << std::endl;
+        return 1;
+    }
+    TextureFormat format = TextureFormat::Bc1;
+    if (argc > 3) {
+        std::string option = argv[3];
+        if (option == "--rgba") {
+            format = TextureFormat::Rgba8;
+        } else if (option == "--bc5") {
+            format = TextureFormat::Bc5;
+        } else if (option != "--bc1") {
+            std::cerr << "unknown format " << option << std::endl;
+            return 1;
+        }
+    }
+
+    sf::Image image;
+    if (!image.loadFromFile(argv[1])) {
+        std::cerr << "Failed to load " << argv[1] << std::endl;
+        return 1;
+    }
+    std::vector<MipLevel> levels = buildMipChain(image.getPixelsPtr(), static_cast<int>(image.getSize().x),
+                                                 static_cast<int>(image.getSize().y));
+    if (!writeTextureFile(argv[2], levels, format)) {
+        std::cerr << "Failed to write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::size_t rgbaBytes = 0;
+    for (const MipLevel& level : levels)
+        rgbaBytes += level.pixels.size();
+    std::cout << argv[2] << ": " << textureFormatName(format) << ", " << levels[0].width << "x" << levels[0].height
+              << ", " << levels.size() << " levels, RGBA8 " << rgbaBytes / 1024 << " KB" << std::endl;
+    return 0;
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "../common/job_system.hpp"
+#include "gl_state.hpp"
+
+// Точечный источник в мировых координатах; за radius вклад обнуляется
+struct PointLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+};
+
+// Кластерное прямое освещение. Пирамида видимости делится на gridX x gridY
+// плиток экрана и gridZ слоёв по экспоненте глубины; каждый кадр источники
+// раскладываются по кластерам, которых касаются их сферы. Фрагментный шейдер
+// (CLUSTERED_LIGHTS) находит свой кластер по gl_FragCoord и глубине и обходит
+// только его список, так что цена фрагмента зависит от плотности источников
+// рядом, а не от их общего числа. Данные уходят в три буферные текстуры:
+// lightData  - RGBA32F, по два texel на источник (позиция и радиус, цвет);
+// lightGrid  - RG32UI, для кластера начало и длина его списка;
+// lightIndices - R32UI, списки индексов источников подряд.
+class ClusteredLights {
+public:
+    static constexpr int gridX = 16;
+    static constexpr int gridY = 12;
+    static constexpr int gridZ = 24;
+    static constexpr int clusterCount = gridX * gridY * gridZ;
+
+    explicit ClusteredLights(JobSystem& jobs) : jobs(jobs), clusterLights(clusterCount), grid(clusterCount * 2) {
+        // До первого update() все списки пусты
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int i = 0; i < 3; ++i) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(GLuint), grid.data(), GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ~ClusteredLights() {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    // При смене проекции или размера экрана: границы кластеров в видовых координатах.
+    // Ближняя и дальняя плоскости берутся из матрицы glm::perspective.
+    void setProjection(const glm::mat4& projection, float width, float height) {
+        scaleX = projection[0][0];
+        scaleY = projection[1][1];
+        nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+        float logRange = std::log(farPlane / nearPlane);
+        clusterScale = glm::vec4(gridX / width, gridY / height, gridZ / logRange, -gridZ * std::log(nearPlane) / logRange);
+
+        bounds.resize(clusterCount);
+        for (int z = 0; z < gridZ; ++z) {
+            float nearDepth = sliceDepth(z), farDepth = sliceDepth(z + 1);
+            for (int y = 0; y < gridY; ++y) {
+                for (int x = 0; x < gridX; ++x) {
+                    float ndcX[2] = {2.0f * x / gridX - 1.0f, 2.0f * (x + 1) / gridX - 1.0f};
+                    float ndcY[2] = {2.0f * y / gridY - 1.0f, 2.0f * (y + 1) / gridY - 1.0f};
+                    // Стороны плитки расходятся с глубиной: крайние значения на ближнем или дальнем срезе
+                    Box& box = bounds[clusterIndex(x, y, z)];
+                    box.min = glm::vec3(std::min(ndcX[0] * nearDepth, ndcX[0] * farDepth) / scaleX,
+                                        std::min(ndcY[0] * nearDepth, ndcY[0] * farDepth) / scaleY, -farDepth);
+                    box.max = glm::vec3(std::max(ndcX[1] * nearDepth, ndcX[1] * farDepth) / scaleX,
+                                        std::max(ndcY[1] * nearDepth, ndcY[1] * farDepth) / scaleY, -nearDepth);
+                }
+            }
+        }
+    }
+
+    // (gridX / ширина, gridY / высота, масштаб и сдвиг log(глубины) в номер слоя)
+    const glm::vec4& getClusterScale() const { return clusterScale; }
+
+    // Раскладка источников по кластерам и загрузка списков в буферные текстуры
+    void update(const std::vector<PointLight>& lights, const glm::mat4& view) {
+        // Видовые координаты сфер и диапазоны кластеров каждого источника
+        ranges.resize(lights.size());
+        jobs.parallelFor(lights.size(), 256, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                ranges[i] = lightRange(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+        });
+
+        // Слои независимы: каждая задача заполняет списки своих кластеров
+        jobs.parallelFor(gridZ, 1, [&](std::size_t begin, std::size_t end) {
+            for (int z = static_cast<int>(begin); z < static_cast<int>(end); ++z)
+                assignSlice(z);
+        });
+
+        // Начала списков и сборка общего массива индексов
+        std::size_t total = 0;
+        for (int cluster = 0; cluster < clusterCount; ++cluster) {
+            grid[cluster * 2] = static_cast<GLuint>(total);
+            grid[cluster * 2 + 1] = static_cast<GLuint>(clusterLights[cluster].size());
+            total += clusterLights[cluster].size();
+        }
+        indices.resize(total);
+        jobs.parallelFor(clusterCount, gridX * gridY, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t cluster = begin; cluster < end; ++cluster)
+                std::copy(clusterLights[cluster].begin(), clusterLights[cluster].end(), indices.begin() + grid[cluster * 2]);
+        });
+        indexCount = total;
+
+        packed.resize(lights.size() * 8);
+        for (std::size_t i = 0; i < lights.size(); ++i) {
+            const PointLight& light = lights[i];
+            GLfloat* out = &packed[i * 8];
+            out[0] = light.position.x;
+            out[1] = light.position.y;
+            out[2] = light.position.z;
+            out[3] = light.radius;
+            out[4] = light.color.x;
+            out[5] = light.color.y;
+            out[6] = light.color.z;
+            out[7] = 0.0f;
+        }
+        upload(0, packed.data(), packed.size() * sizeof(GLfloat));
+        upload(1, grid.data(), grid.size() * sizeof(GLuint));
+        upload(2, indices.data(), indices.size() * sizeof(GLuint));
+    }
+
+    // Буферные текстуры lightData, lightGrid, lightIndices на блоки firstUnit..firstUnit+2
+    void bind(GlState& state, GLuint firstUnit) const {
+        for (GLuint i = 0; i < 3; ++i)
+            state.bindTexture(firstUnit + i, GL_TEXTURE_BUFFER, textures[i]);
+    }
+
+    // Среднее число источников на непустой кластер и самый длинный список
+    float getAverageListLength() const {
+        std::size_t occupied = 0;
+        for (int cluster = 0; cluster < clusterCount; ++cluster)
+            occupied += grid[cluster * 2 + 1] != 0;
+        return occupied ? static_cast<float>(indexCount) / occupied : 0.0f;
+    }
+
+    std::size_t getMaxListLength() const {
+        GLuint longest = 0;
+        for (int cluster = 0; cluster < clusterCount; ++cluster)
+            longest = std::max(longest, grid[cluster * 2 + 1]);
+        return longest;
+    }
+
+private:
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    // Сфера в видовых координатах и её кластеры; x0 > x1 - источник не виден
+    struct Range {
+        glm::vec3 center;
+        float radius;
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    JobSystem& jobs;
+    GLuint buffers[3] = {};
+    GLuint textures[3] = {};
+    float scaleX = 1.0f, scaleY = 1.0f;
+    float nearPlane = 0.1f, farPlane = 100.0f;
+    glm::vec4 clusterScale = glm::vec4(0.0f);
+    std::vector<Box> bounds;
+    std::vector<Range> ranges;
+    std::vector<std::vector<GLuint>> clusterLights;
+    std::vector<GLuint> grid;
+    std::vector<GLuint> indices;
+    std::vector<GLfloat> packed;
+    std::size_t indexCount = 0;
+
+    static int clusterIndex(int x, int y, int z) { return (z * gridY + y) * gridX + x; }
+
+    float sliceDepth(int slice) const { return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / gridZ); }
+
+    int depthSlice(float depth) const {
+        int slice = static_cast<int>(std::floor(std::log(depth) * clusterScale.z + clusterScale.w));
+        return std::max(0, std::min(gridZ - 1, slice));
+    }
+
+    static int tile(float ndc, int count) {
+        return std::max(0, std::min(count - 1, static_cast<int>(std::floor((ndc + 1.0f) * 0.5f * count))));
+    }
+
+    // Консервативные границы сферы: слои по глубине, плитки по проекции её
+    // ограничивающего параллелепипеда (x / глубина крайнее на ближней или дальней грани)
+    Range lightRange(const glm::vec3& center, float radius) const {
+        Range range{center, radius, 1, 0, 1, 0, 1, 0};
+        float depthMin = -center.z - radius, depthMax = -center.z + radius;
+        if (depthMax < nearPlane || depthMin > farPlane)
+            return range;
+        range.z0 = depthSlice(std::max(depthMin, nearPlane));
+        range.z1 = depthSlice(std::min(depthMax, farPlane));
+        if (depthMin <= nearPlane) {
+            // Сфера пересекает ближнюю плоскость - проекция неограничена
+            range.x0 = 0, range.x1 = gridX - 1;
+            range.y0 = 0, range.y1 = gridY - 1;
+            return range;
+        }
+        float lo[2], hi[2];
+        const float scale[2] = {scaleX, scaleY};
+        for (int axis = 0; axis < 2; ++axis) {
+            float a = (center[axis] - radius) * scale[axis], b = (center[axis] + radius) * scale[axis];
+            lo[axis] = std::min(a / depthMin, a / depthMax);
+            hi[axis] = std::max(b / depthMin, b / depthMax);
+            if (hi[axis] < -1.0f || lo[axis] > 1.0f)
+                return range;
+        }
+        range.x0 = tile(lo[0], gridX), range.x1 = tile(hi[0], gridX);
+        range.y0 = tile(lo[1], gridY), range.y1 = tile(hi[1], gridY);
+        return range;
+    }
+
+    // Точная проверка сферы с границами каждого кластера из диапазона
+    void assignSlice(int z) {
+        for (int cluster = clusterIndex(0, 0, z); cluster < clusterIndex(0, 0, z + 1); ++cluster)
+            clusterLights[cluster].clear();
+        for (std::size_t i = 0; i < ranges.size(); ++i) {
+            const Range& range = ranges[i];
+            if (z < range.z0 || z > range.z1)
+                continue;
+            float radius2 = range.radius * range.radius;
+            for (int y = range.y0; y <= range.y1; ++y) {
+                for (int x = range.x0; x <= range.x1; ++x) {
+                    int cluster = clusterIndex(x, y, z);
+                    const Box& box = bounds[cluster];
+                    glm::vec3 nearest = glm::clamp(range.center, box.min, box.max);
+                    glm::vec3 offset = range.center - nearest;
+                    if (glm::dot(offset, offset) <= radius2)
+                        clusterLights[cluster].push_back(static_cast<GLuint>(i));
+                }
+            }
+        }
+    }
+
+    void upload(int index, const void* data, std::size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[index]);
+        // "Сиротство" буфера, как у InstanceBuffer без постоянного отображения
+        glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+        if (size)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <unordered_map>
+
+// Тень состояния GL: текущая программа, VAO, активный текстурный блок,
+// привязки текстур по блокам и включённые режимы (glEnable). Запрос,
+// совпадающий с тенью, в драйвер не уходит. Пока тень не знает значения
+// (в начале и после invalidate()), вызов выполняется всегда.
+// Код, меняющий это состояние напрямую, должен после себя вызвать invalidate().
+class GlState {
+public:
+    // Вызовы GL за кадр: выполненные и пропущенные как повторные
+    struct Counters {
+        std::size_t issued = 0;
+        std::size_t elided = 0;
+    };
+
+    static constexpr int maxUnits = 16;
+
+    GlState() { invalidate(); }
+
+    void useProgram(GLuint program) {
+        if (count(program == currentProgram))
+            return;
+        glUseProgram(program);
+        currentProgram = program;
+    }
+
+    void bindVertexArray(GLuint vao) {
+        if (count(vao == currentVao))
+            return;
+        glBindVertexArray(vao);
+        currentVao = vao;
+    }
+
+    // Учитывается как пара glActiveTexture + glBindTexture
+    void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+        int slot = targetSlot(target);
+        if (unit >= static_cast<GLuint>(maxUnits) || slot < 0) {
+            activeTexture(unit);
+            ++frame.issued;
+            glBindTexture(target, texture);
+            return;
+        }
+        GLuint& bound = textures[unit][slot];
+        if (texture == bound) {
+            frame.elided += 2;
+            return;
+        }
+        activeTexture(unit);
+        ++frame.issued;
+        glBindTexture(target, texture);
+        bound = texture;
+    }
+
+    void setEnabled(GLenum capability, bool enabled) {
+        auto found = capabilities.find(capability);
+        if (count(found != capabilities.end() && found->second == enabled))
+            return;
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+        capabilities[capability] = enabled;
+    }
+
+    void enable(GLenum capability) { setEnabled(capability, true); }
+    void disable(GLenum capability) { setEnabled(capability, false); }
+
+    // Забыть привязки текстур (их меняли в обход, например при загрузке)
+    void invalidateTextures() {
+        activeUnit = unknown;
+        for (auto& unitTextures : textures) {
+            for (GLuint& texture : unitTextures)
+                texture = unknown;
+        }
+    }
+
+    void invalidate() {
+        currentProgram = unknown;
+        currentVao = unknown;
+        capabilities.clear();
+        invalidateTextures();
+    }
+
+    // Начало кадра: счётчики прошлого кадра доступны через getLastFrame()
+    void beginFrame() {
+        lastFrame = frame;
+        frame = Counters();
+    }
+
+    const Counters& getLastFrame() const { return lastFrame; }
+    const Counters& getFrame() const { return frame; }
+
+private:
+    // Такого имени GL не выдаёт, им помечено неизвестное значение
+    static constexpr GLuint unknown = ~0u;
+    static constexpr int targetCount = 3;
+
+    GLuint currentProgram = unknown;
+    GLuint currentVao = unknown;
+    GLuint activeUnit = unknown;
+    GLuint textures[maxUnits][targetCount];
+    std::unordered_map<GLenum, bool> capabilities;
+    Counters frame;
+    Counters lastFrame;
+
+    static int targetSlot(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_2D_ARRAY:
+            return 1;
+        case GL_TEXTURE_BUFFER:
+            return 2;
+        default:
+            return -1;
+        }
+    }
+
+    // true - вызов лишний; счётчики обновляются в обоих случаях
+    bool count(bool redundant) {
+        ++(redundant ? frame.elided : frame.issued);
+        return redundant;
+    }
+
+    void activeTexture(GLuint unit) {
+        if (count(unit == activeUnit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+};
@@ -0,0 +1,154 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Данные экземпляра: модельная матрица, уже посчитанная матрица нормалей,
+// чтобы вершинный шейдер не обращал матрицу для каждой вершины, и номер
+// материала (слой массивов текстур, materials.hpp)
+struct InstanceData {
+    glm::mat4 model;
+    GLfloat normalMatrix[9];
+    GLuint material;
+};
+
+// transpose(inverse(mat3(model))) - верна и при неравномерном масштабе
+inline glm::mat3 normalMatrix(const glm::mat4& model) {
+    return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+inline InstanceData makeInstance(const glm::mat4& model, GLuint material = 0) {
+    InstanceData instance;
+    instance.model = model;
+    instance.material = material;
+    glm::mat3 normal = normalMatrix(model);
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row)
+            instance.normalMatrix[column * 3 + row] = normal[column][row];
+    }
+    return instance;
+}
+
+// Поток данных экземпляров в атрибуты с делителем 1: aModel занимает
+// расположения first..first+3, aNormalMatrix - first+4..first+6, aMaterial - first+7.
+// При OpenGL 4.4 (или ARB_buffer_storage) буфер постоянно отображён и поделён
+// на три сегмента: кадр пишет в свой сегмент, а перед повторной записью ждёт
+// забор (fence) кадра, который читал его раньше. Иначе буфер каждый кадр
+// "осиротевает" через glBufferData(nullptr) и заполняется glBufferSubData.
+class InstanceBuffer {
+public:
+    explicit InstanceBuffer(GLuint firstLocation)
+        : firstLocation(firstLocation), persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {}
+
+    ~InstanceBuffer() { release(); }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    bool isPersistent() const { return persistent; }
+
+    // Загрузка экземпляров кадра и настройка атрибутов; нужный VAO уже привязан
+    void upload(const std::vector<InstanceData>& instances) {
+        if (instances.size() > capacity)
+            reserve(instances.size() * 2);
+
+        std::size_t offset = 0;
+        std::size_t size = instances.size() * sizeof(InstanceData);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (persistent) {
+            segment = (segment + 1) % segmentCount;
+            waitSegment(segment);
+            offset = segment * capacity * sizeof(InstanceData);
+            std::memcpy(mapped + offset, instances.data(), size);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+        }
+        bindAttributes(offset);
+    }
+
+    // Вызывается после отрисовки, прочитавшей данные последнего upload()
+    void finishFrame() {
+        if (!persistent)
+            return;
+        if (fences[segment])
+            glDeleteSync(fences[segment]);
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    static constexpr std::size_t segmentCount = 3;
+
+    GLuint firstLocation;
+    bool persistent;
+    GLuint buffer = 0;
+    std::size_t capacity = 0;
+    unsigned char* mapped = nullptr;
+    std::size_t segment = 0;
+    GLsync fences[segmentCount] = {};
+
+    void reserve(std::size_t count) {
+        release();
+        capacity = count;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr size = static_cast<GLsizeiptr>(segmentCount * capacity * sizeof(InstanceData));
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        }
+    }
+
+    void release() {
+        for (GLsync& fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (buffer) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            if (mapped)
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = 0;
+        mapped = nullptr;
+    }
+
+    void waitSegment(std::size_t index) {
+        if (!fences[index])
+            return;
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (glClientWaitSync(fences[index], flags, 1000000) == GL_TIMEOUT_EXPIRED)
+            flags = 0;
+        glDeleteSync(fences[index]);
+        fences[index] = nullptr;
+    }
+
+    void bindAttributes(std::size_t offset) {
+        const GLsizei stride = sizeof(InstanceData);
+        for (GLuint column = 0; column < 4; ++column) {
+            GLuint location = firstLocation + column;
+            std::size_t columnOffset = offset + offsetof(InstanceData, model) + column * 4 * sizeof(GLfloat);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(columnOffset));
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        for (GLuint column = 0; column < 3; ++column) {
+            GLuint location = firstLocation + 4 + column;
+            std::size_t columnOffset = offset + offsetof(InstanceData, normalMatrix) + column * 3 * sizeof(GLfloat);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(columnOffset));
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        GLuint location = firstLocation + 7;
+        std::size_t materialOffset = offset + offsetof(InstanceData, material);
+        glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, stride, reinterpret_cast<void*>(materialOffset));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+};
@@ -5,18 +5,41 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
 #include <iostream>
-
-// Структура вершины
-struct Vertex {
-    GLfloat position[3];
-    GLfloat texCoord[2];
-    GLfloat normal[3];
-    GLfloat tangent[3];
-    GLfloat bitangent[3];
-};
-
-// Вершины куба (полный массив вершины)
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shader_program.hpp"
+#include "instancing.hpp"
+#include "mesh.hpp"
+#include "vertex_format.hpp"
+#include "texture_streamer.hpp"
+#include "clustered_lights.hpp"
+#include "gl_state.hpp"
+#include "materials.hpp"
+
+// g++ -std=c++17 -O2 -pthread main.cpp -lsfml-graphics -lsfml-window -lsfml-system -lGLEW -lGL
+// ./a.out --instances N - сетка из N кубов одним вызовом (по умолчанию 1000)
+// ./a.out --mesh model.obj - модель из OBJ вместо куба (вписывается в куб [-1, 1]^3)
+// ./a.out --packed | --packed-half - упакованные вершины: 20 байт (квантованные позиции
+//     и UV) или 28 байт (float-позиции, half-UV) вместо 56
+// ./a.out --lights N - ещё N движущихся точечных источников над сеткой (кластерное
+//     освещение, в замерах --bench не участвует)
+// ./a.out --materials N - N материалов (оттенки 2.jpg, карта нормалей 3.jpg или плоская)
+//     в массивах текстур; экземпляры сетки получают их по кругу и рисуются одним вызовом
+// ./a.out --bench - время кадра для 1..100k кубов: отдельные вызовы и инстансинг
+// ./bake_textures 2.jpg 2.tex --bc1 && ./bake_textures 3.jpg 3.tex --bc5 - готовые текстуры
+//     с мип-уровнями; при наличии .tex загружаются вместо JPEG
+// I - переключение между одним кубом и сеткой экземпляров
+
+// Вершины куба (полный массив вершины); склеиваются в индексированную сетку при запуске,
+// касательные пересчитываются generateTangents()
 Vertex vertices[] = {
     // Позиции          // Текстурные координаты // Нормали         // Тангенты         // Битангенты
     // Передняя грань
@@ -68,55 +91,131 @@ Vertex vertices[] = {
     {{-1.0f,  1.0f, -1.0f}, {0.0f, 1.0f}, {0.0f,  1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}
 };
 
-// Функция для загрузки текстуры
-GLuint loadTexture(const char* path) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    sf::Image imgData;
-    if (!imgData.loadFromFile(path)) {
-        std::cerr << "Failed to load texture" << std::endl;
-        return 0;
-    }
-    // Генерация текстуры
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imgData.getSize().x, imgData.getSize().y, 0, GL_RGBA, GL_UNSIGNED_BYTE, imgData.getPixelsPtr());
-    glGenerateMipmap(GL_TEXTURE_2D);
-    return textureID;
-}
+// Данные кадра и объекта в раскладке std140 (повторяют блоки FrameData и ObjectData в шейдерах)
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 lightPos;
+    glm::vec4 viewPos;
+    GLint useNormalMap;
+    GLint padding[3];
+    glm::vec4 clusterScale; // ClusteredLights::getClusterScale()
+};
 
-// Вершинный шейдер
+// Матрица нормалей хранится как mat4, используется верхний левый блок 3x3
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    GLint material;
+    GLint padding[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 192, "FrameUniforms must match std140 layout");
+static_assert(sizeof(ObjectUniforms) == 144, "ObjectUniforms must match std140 layout");
+
+const GLuint frameBinding = 0;
+const GLuint objectBinding = 1;
+const GLuint instanceLocation = 5;
+const GLuint lightTextureUnit = 2; // lightData, lightGrid, lightIndices - блоки 2..4
+
+// Вершинный шейдер; матрица нормалей считается на процессоре.
+// INSTANCED - матрицы приходят атрибутами с делителем 1 вместо блока ObjectData,
+// PACKED_VERTICES - вершины в упакованном формате (vertex_format.hpp),
+// MATERIAL_ARRAYS - номер материала (слой массивов текстур) передаётся фрагментному шейдеру.
 const char* vertexShaderSource = R"(
 #version 330 core
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoord;
+#ifdef PACKED_VERTICES
+layout(location = 2) in vec2 aNormal;
+layout(location = 3) in vec2 aTangent;
+layout(location = 4) in float aHandedness;
+#else
 layout(location = 2) in vec3 aNormal;
 layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitangent;
+#endif
+#ifdef INSTANCED
+layout(location = 5) in mat4 aModel;
+layout(location = 9) in mat3 aNormalMatrix;
+layout(location = 12) in uint aMaterial;
+#endif
 
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 Tangent;
 out vec3 Bitangent;
+#ifdef MATERIAL_ARRAYS
+flat out int MaterialLayer;
+#endif
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 viewPos;
+    int useNormalMap;
+    vec4 clusterScale;
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#ifndef INSTANCED
+layout(std140) uniform ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    int material;
+};
+#endif
+
+#ifdef PACKED_VERTICES
+uniform vec4 positionTransform;
+uniform vec4 texCoordTransform;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+#endif
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    Tangent = mat3(transpose(inverse(model))) * aTangent;
-    Bitangent = mat3(transpose(inverse(model))) * aBitangent;
+#ifdef INSTANCED
+    mat4 modelMatrix = aModel;
+    mat3 normalMatrix3 = aNormalMatrix;
+#ifdef MATERIAL_ARRAYS
+    MaterialLayer = int(aMaterial);
+#endif
+#else
+    mat4 modelMatrix = model;
+    mat3 normalMatrix3 = mat3(normalMatrix);
+#ifdef MATERIAL_ARRAYS
+    MaterialLayer = material;
+#endif
+#endif
+#ifdef PACKED_VERTICES
+    vec3 position = aPos * positionTransform.w + positionTransform.xyz;
+    vec3 normal = decodeOctahedral(aNormal);
+    vec3 tangent = decodeOctahedral(aTangent);
+    vec3 bitangent = cross(normal, tangent) * aHandedness;
+    TexCoord = aTexCoord * texCoordTransform.zw + texCoordTransform.xy;
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent;
+    vec3 bitangent = aBitangent;
     TexCoord = aTexCoord;
+#endif
+    FragPos = vec3(modelMatrix * vec4(position, 1.0));
+    Normal = normalMatrix3 * normal;
+    Tangent = normalMatrix3 * tangent;
+    Bitangent = normalMatrix3 * bitangent;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
 )";
 
-// Фрагментный шейдер
-
-
-
+// Фрагментный шейдер. CLUSTERED_LIGHTS - к основному источнику добавляются
+// точечные из списка кластера фрагмента (clustered_lights.hpp)
 const char* fragmentShaderSource = R"(
 #version 330 core
 out vec4 FragColor;
@@ -127,17 +226,52 @@ in vec3 Normal;
 in vec3 Tangent;
 in vec3 Bitangent;
 
+#ifdef MATERIAL_ARRAYS
+uniform sampler2DArray texture1;
+uniform sampler2DArray normalMap;
+flat in int MaterialLayer;
+#define sampleMaterial(map) texture(map, vec3(TexCoord, float(MaterialLayer)))
+#else
 uniform sampler2D texture1;
 uniform sampler2D normalMap;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform bool useNormalMap;
+#define sampleMaterial(map) texture(map, TexCoord)
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+const ivec3 clusterGrid = ivec3(CLUSTER_GRID);
+#endif
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 viewPos;
+    int useNormalMap;
+    vec4 clusterScale;
+};
+
+// Диффузная и зеркальная составляющие от источника в направлении lightDir
+vec3 shade(vec3 lightDir, vec3 radiance, vec3 normal, vec3 viewDir, vec3 albedo) {
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    return (diff * albedo + vec3(0.5) * spec) * radiance;
+}
 
 void main() {
     vec3 normal;
-    if (useNormalMap) {
-        normal = texture(normalMap, TexCoord).rgb;
+    if (useNormalMap != 0) {
+#ifdef TWO_CHANNEL_NORMAL_MAP
+        // BC5 хранит только X и Y, Z восстанавливается из единичной длины
+        normal.xy = sampleMaterial(normalMap).rg * 2.0 - 1.0;
+        normal.z = sqrt(max(0.0, 1.0 - dot(normal.xy, normal.xy)));
+#else
+        normal = sampleMaterial(normalMap).rgb;
         normal = normalize(normal * 2.0 - 1.0);
+#endif
         vec3 T = normalize(Tangent);
         vec3 B = normalize(Bitangent);
         vec3 N = normalize(Normal);
@@ -148,64 +282,225 @@ void main() {
     }
 
 
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float diff = max(dot(normal, lightDir), 0.0);
-    vec3 diffuse = diff * vec3(1.0, 1.0, 1.0) * texture(texture1, TexCoord).rgb;
-
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
-    vec3 specular = vec3(0.5) * spec;
+    vec3 albedo = sampleMaterial(texture1).rgb;
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+    vec3 result = shade(normalize(lightPos.xyz - FragPos), vec3(1.0), normal, viewDir, albedo);
+
+#ifdef CLUSTERED_LIGHTS
+    // Кластер: плитка экрана и экспоненциальный слой видовой глубины
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterScale.xy), int(floor(log(depth) * clusterScale.z + clusterScale.w)));
+    cluster = clamp(cluster, ivec3(0), clusterGrid - 1);
+    uvec2 list = texelFetch(lightGrid, (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x).rg;
+    for (uint i = 0u; i < list.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(list.x + i)).r);
+        vec4 positionRadius = texelFetch(lightData, light * 2);
+        vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float distance2 = dot(toLight, toLight);
+        // Обратные квадраты, плавно сведённые к нулю на радиусе источника
+        float window = clamp(1.0 - distance2 * distance2 / pow(positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance2 + 1.0);
+        if (attenuation > 0.0)
+            result += shade(toLight * inversesqrt(distance2), color * attenuation, normal, viewDir, albedo);
+    }
+#endif
 
-    vec3 result = diffuse + specular;
     FragColor = vec4(result, 1.0);
 }
 )";
 
-// Компиляция шейдера
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-
-    // Проверка на ошибки компиляции
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLchar infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+glm::mat4 cubeRotation(float rotationX, float rotationY) {
+    glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::rotate(model, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Кубы на квадратной сетке в плоскости XY; у каждого свой сдвиг угла,
+// материалы назначаются по кругу
+void fillInstanceGrid(std::vector<InstanceData>& instances, std::size_t count, float rotationX, float rotationY,
+                      std::size_t materialCount = 1) {
+    instances.resize(count);
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    for (std::size_t i = 0; i < count; ++i) {
+        float x = (static_cast<int>(i % side) - (side - 1) / 2.0f) * 3.0f;
+        float y = (static_cast<int>(i / side) - (side - 1) / 2.0f) * 3.0f;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+        instances[i] = makeInstance(model * cubeRotation(rotationX + i * 7.0f, rotationY + i * 13.0f),
+                                    static_cast<GLuint>(i % std::max<std::size_t>(materialCount, 1)));
+    }
+}
+
+// Оттенки 2.jpg: нулевой материал без оттенка, у каждого четвёртого плоская карта нормалей
+std::vector<MaterialDesc> makeMaterials(std::size_t count) {
+    std::vector<MaterialDesc> materials(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        materials[i].albedoPath = "2.jpg";
+        materials[i].normalPath = i % 4 == 3 ? "" : "3.jpg";
+        if (i > 0) {
+            // Шаг по золотому сечению равномерно обходит круг оттенков
+            float hue = std::fmod(i * 0.618034f, 1.0f) * 6.0f;
+            glm::vec3 rgb(std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f));
+            materials[i].tint = glm::mix(glm::vec3(1.0f), glm::clamp(rgb, 0.0f, 1.0f), 0.6f);
+        }
+    }
+    return materials;
+}
+
+// Источники над сеткой из instanceCount кубов: случайные центры, радиусы и цвета
+std::vector<PointLight> makeLights(std::size_t count, std::size_t instanceCount) {
+    float side = std::ceil(std::sqrt(static_cast<float>(std::max<std::size_t>(instanceCount, 1))));
+    float half = (side - 1.0f) * 1.5f + 2.0f;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> across(-half, half), depth(-1.5f, 2.5f), radius(1.5f, 3.5f), channel(0.2f, 1.0f);
+    std::vector<PointLight> lights(count);
+    for (PointLight& light : lights) {
+        light.position.x = across(random);
+        light.position.y = across(random);
+        light.position.z = depth(random);
+        light.radius = radius(random);
+        float red = channel(random), green = channel(random), blue = channel(random);
+        light.color = glm::vec3(red, green, blue) * 1.5f;
+    }
+    return lights;
+}
+
+// Каждый источник кружит вокруг исходной точки со своими фазой и скоростью
+void animateLights(const std::vector<PointLight>& base, std::vector<PointLight>& lights, float time) {
+    lights.resize(base.size());
+    for (std::size_t i = 0; i < base.size(); ++i) {
+        float angle = i * 2.39996f + time * (0.5f + (i % 7) * 0.15f);
+        lights[i] = base[i];
+        lights[i].position += glm::vec3(std::cos(angle), std::sin(angle), 0.0f);
+    }
+}
+
+// Камера на оси Z, отодвинутая так, чтобы сетка помещалась в кадр; свет у камеры
+void setCamera(FrameUniforms& frame, std::size_t instanceCount) {
+    float side = std::ceil(std::sqrt(static_cast<float>(instanceCount)));
+    float distance = std::max(5.0f, side * 3.0f * 1.3f);
+    frame.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -distance));
+    frame.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, distance + 100.0f);
+    if (instanceCount == 0) {
+        // Один куб: прежние свет и позиция наблюдателя
+        frame.lightPos = glm::vec4(1.2f, 1.0f, 2.0f, 1.0f);
+        frame.viewPos = glm::vec4(0.0f, 0.0f, 3.0f, 1.0f);
+    } else {
+        frame.lightPos = glm::vec4(distance * 0.3f, distance * 0.3f, distance * 0.5f, 1.0f);
+        frame.viewPos = glm::vec4(0.0f, 0.0f, distance, 1.0f);
     }
+}
 
-    return shader;
+ObjectUniforms makeObjectUniforms(const InstanceData& instance) {
+    ObjectUniforms object;
+    object.model = instance.model;
+    object.normalMatrix = glm::mat4(1.0f);
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row)
+            object.normalMatrix[column][row] = instance.normalMatrix[column * 3 + row];
+    }
+    object.material = static_cast<GLint>(instance.material);
+    return object;
 }
 
-// Создание шейдерной программы
-GLuint createProgram(const char* vertexSource, const char* fragmentSource) {
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
-
-    // Проверка на ошибки компоновки
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        GLchar infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
-        std::cerr << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+// Каждый куб отдельным вызовом со своим буфером объекта
+void drawSeparately(GlState& state, const std::vector<InstanceData>& instances, const ShaderProgram& program, GLuint vao,
+                    GLsizei indexCount, UniformBuffer<ObjectUniforms>& objectUniforms) {
+    program.use(state);
+    state.bindVertexArray(vao);
+    for (const InstanceData& instance : instances) {
+        objectUniforms.edit() = makeObjectUniforms(instance);
+        objectUniforms.upload();
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
     }
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+// Все кубы одним вызовом
+void drawInstanced(GlState& state, const std::vector<InstanceData>& instances, const ShaderProgram& program, GLuint vao,
+                   GLsizei indexCount, InstanceBuffer& instanceBuffer) {
+    program.use(state);
+    state.bindVertexArray(vao);
+    instanceBuffer.upload(instances);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(instances.size()));
+    instanceBuffer.finishFrame();
+}
 
-    return program;
+void runBenchmark(sf::Window& window, GlState& state, const ShaderProgram& program, const ShaderProgram& instancedProgram,
+                  GLuint vao, GLuint instancedVao, GLsizei indexCount, UniformBuffer<FrameUniforms>& frameUniforms,
+                  UniformBuffer<ObjectUniforms>& objectUniforms, InstanceBuffer& instanceBuffer, std::size_t materialCount) {
+    const int frames = 30;
+    std::vector<InstanceData> instances;
+    for (std::size_t count : {std::size_t(1), std::size_t(100), std::size_t(1000), std::size_t(10000), std::size_t(100000)}) {
+        setCamera(frameUniforms.edit(), count);
+        frameUniforms.upload();
+        for (bool instanced : {false, true}) {
+            GlState::Counters calls;
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; ++frame) {
+                state.beginFrame();
+                fillInstanceGrid(instances, count, frame * 3.0f, frame * 2.0f, materialCount);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if (instanced) {
+                    drawInstanced(state, instances, instancedProgram, instancedVao, indexCount, instanceBuffer);
+                } else {
+                    drawSeparately(state, instances, program, vao, indexCount, objectUniforms);
+                }
+                window.display();
+                glFinish();
+                calls.issued += state.getFrame().issued;
+                calls.elided += state.getFrame().elided;
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "cubes: " << count << ", " << (instanced ? "instanced" : "draw calls") << ": "
+                      << elapsed.count() / frames << " ms/frame, state calls/frame: " << calls.issued / frames << " issued, "
+                      << calls.elided / frames << " elided" << std::endl;
+        }
+    }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool benchmark = false;
+    std::size_t instanceCount = 1000;
+    std::size_t lightCount = 0;
+    std::size_t materialCount = 0;
+    std::string meshPath;
+    VertexFormat vertexFormat = VertexFormat::Full;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bench") {
+            benchmark = true;
+        } else if (arg == "--instances" && i + 1 < argc) {
+            instanceCount = std::stoul(argv[++i]);
+        } else if (arg == "--lights" && i + 1 < argc) {
+            lightCount = std::stoul(argv[++i]);
+        } else if (arg == "--materials" && i + 1 < argc) {
+            materialCount = std::stoul(argv[++i]);
+        } else if (arg == "--mesh" && i + 1 < argc) {
+            meshPath = argv[++i];
+        } else if (arg == "--packed") {
+            vertexFormat = VertexFormat::PackedQuantised;
+        } else if (arg == "--packed-half") {
+            vertexFormat = VertexFormat::PackedHalfUv;
+        }
+    }
+
+    // Геометрия: склейка вершин, касательные, порядок под кэш вершин
+    MeshData mesh;
+    if (meshPath.empty()) {
+        mesh = weldVertices(vertices, sizeof(vertices) / sizeof(vertices[0]));
+    } else if (loadObj(meshPath, mesh)) {
+        fitToUnitCube(mesh);
+    } else {
+        std::cerr << "Failed to load mesh " << meshPath << std::endl;
+        return -1;
+    }
+    float missRatioBefore = averageCacheMissRatio(mesh.indices, mesh.vertices.size());
+    prepareMesh(mesh);
+    std::cout << "vertices: " << mesh.vertices.size() << ", triangles: " << mesh.indices.size() / 3
+              << ", ACMR: " << missRatioBefore << " -> " << averageCacheMissRatio(mesh.indices, mesh.vertices.size()) << std::endl;
+    const GLsizei indexCount = static_cast<GLsizei>(mesh.indices.size());
+    PackedMesh packed = packVertices(mesh, vertexFormat);
+    std::cout << "vertex size: " << packed.stride << " bytes, vertex buffer: " << packed.data.size() / 1024.0 << " KB" << std::endl;
+
     // Настройка окна
     sf::Window window(sf::VideoMode(800, 600), "lab4", sf::Style::Default, sf::ContextSettings(24));
     window.setVerticalSyncEnabled(true);
@@ -220,42 +515,156 @@ int main() {
         return -1;
     }
 
-    // Компиляция и создание шейдерной программы
-    GLuint shaderProgram = createProgram(vertexShaderSource, fragmentShaderSource);
+    // Текстуры: готовые контейнеры .tex (bake_textures.cpp) отображаются в память
+    // и загружаются сразу со всеми уровнями. Без них JPEG декодируются в фоне и
+    // догружаются по кадрам, а до этого рисуются заглушки: серый цвет и плоская
+    // нормаль. Декодирует свой поток стримера, главный в этом не участвует.
+    JobSystem jobs;
+    TextureStreamer textures;
+    // С --materials все материалы уже лежат в массивах текстур, отдельные не нужны
+    std::unique_ptr<MaterialArrays> materials;
+    if (materialCount > 0) {
+        materials = std::make_unique<MaterialArrays>();
+        if (!materials->build(jobs, makeMaterials(materialCount), 256))
+            return -1;
+        std::cout << "materials: " << materials->getLayerCount() << ", layers " << materials->getWidth() << "x"
+                  << materials->getHeight() << ", " << materials->getBytes() / 1024 << " KB" << std::endl;
+    }
+    BakedTexture bakedAlbedo = materials ? BakedTexture() : loadTextureFile("2.tex");
+    BakedTexture bakedNormalMap = materials ? BakedTexture() : loadTextureFile("3.tex");
+    for (const BakedTexture* baked : {&bakedAlbedo, &bakedNormalMap}) {
+        if (baked->texture)
+            std::cout << (baked == &bakedAlbedo ? "2.tex: " : "3.tex: ") << textureFormatName(baked->format) << ", "
+                      << baked->bytes / 1024 << " KB" << std::endl;
+    }
+    const unsigned char grey[4] = {128, 128, 128, 255};
+    const unsigned char flatNormal[4] = {128, 128, 255, 255};
+    int texture1 = materials || bakedAlbedo.texture ? -1 : textures.request("2.jpg", grey);
+    int normalMap = materials || bakedNormalMap.texture ? -1 : textures.request("3.jpg", flatNormal);
+    auto bindTextures = [&](GlState& state) {
+        if (materials) {
+            state.bindTexture(0, GL_TEXTURE_2D_ARRAY, materials->getAlbedo());
+            state.bindTexture(1, GL_TEXTURE_2D_ARRAY, materials->getNormals());
+            return;
+        }
+        state.bindTexture(0, GL_TEXTURE_2D, bakedAlbedo.texture ? bakedAlbedo.texture : textures.getTexture(texture1));
+        state.bindTexture(1, GL_TEXTURE_2D, bakedNormalMap.texture ? bakedNormalMap.texture : textures.getTexture(normalMap));
+    };
+
+    // Компиляция и создание шейдерных программ; сэмплеры и блоки привязываются один раз.
+    // Скомпонованные программы сохраняются в .shader_cache и со второго запуска
+    // загружаются оттуда без компиляции
+    std::string defines = vertexFormat != VertexFormat::Full ? "#define PACKED_VERTICES\n" : "";
+    if (bakedNormalMap.texture && bakedNormalMap.format == TextureFormat::Bc5)
+        defines += "#define TWO_CHANNEL_NORMAL_MAP\n";
+    if (materials)
+        defines += "#define MATERIAL_ARRAYS\n";
+    if (lightCount > 0 && !benchmark) {
+        defines += "#define CLUSTERED_LIGHTS\n#define CLUSTER_GRID " + std::to_string(ClusteredLights::gridX) + ", " +
+                   std::to_string(ClusteredLights::gridY) + ", " + std::to_string(ClusteredLights::gridZ) + "\n";
+    }
+    ProgramCache programCache;
+    auto compileStart = std::chrono::steady_clock::now();
+    ShaderProgram shaderProgram(vertexShaderSource, fragmentShaderSource, defines, &programCache);
+    ShaderProgram instancedProgram(vertexShaderSource, fragmentShaderSource, defines + "#define INSTANCED\n", &programCache);
+    if (programCache.isSupported())
+        std::cout << "Shader programs: " << programCache.getHits() << " cached, " << programCache.getMisses() << " compiled, "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count() << " ms"
+                  << std::endl;
+    for (const ShaderProgram* program : {&shaderProgram, &instancedProgram}) {
+        program->setSampler("texture1", 0);
+        program->setSampler("normalMap", 1);
+        program->setSampler("lightData", lightTextureUnit);
+        program->setSampler("lightGrid", lightTextureUnit + 1);
+        program->setSampler("lightIndices", lightTextureUnit + 2);
+        program->bindUniformBlock("FrameData", frameBinding);
+        program->bindUniformBlock("ObjectData", objectBinding);
+        const glm::vec4& p = packed.positionTransform;
+        const glm::vec4& t = packed.texCoordTransform;
+        program->setVector("positionTransform", p.x, p.y, p.z, p.w);
+        program->setVector("texCoordTransform", t.x, t.y, t.z, t.w);
+    }
 
-    // Настройка вершинного массива и буферов
-    GLuint VAO, VBO;
+    // Настройка вершинных массивов и буферов: второй VAO дополнительно
+    // получает атрибуты экземпляров при каждой загрузке InstanceBuffer
+    GLuint VAO, instancedVAO, VBO, EBO;
     glGenVertexArrays(1, &VAO);
+    glGenVertexArrays(1, &instancedVAO);
     glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
+    glGenBuffers(1, &EBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Настройка атрибутов вершин
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-    glEnableVertexAttribArray(4);
-
-    // Загрузка текстур
-    GLuint texture1 = loadTexture("2.jpg");
-    GLuint normalMap = loadTexture("3.jpg");
-
-    // Матрицы и углы поворота
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f));
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glBufferData(GL_ARRAY_BUFFER, packed.data.size(), packed.data.data(), GL_STATIC_DRAW);
+    for (GLuint vao : {VAO, instancedVAO}) {
+        glBindVertexArray(vao);
+        setupPackedAttributes(packed);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+    InstanceBuffer instanceBuffer(instanceLocation);
+
+    // Вид, проекция и свет не меняются: буфер кадра отправляется только при
+    // переключении карты нормалей или режима, буфер объекта - только после поворота
+    UniformBuffer<FrameUniforms> frameUniforms(frameBinding);
+    UniformBuffer<ObjectUniforms> objectUniforms(objectBinding);
+    bool useNormalMap = true; // Флаг для переключения
+    frameUniforms.edit().useNormalMap = useNormalMap;
+
+    // Дальше программы, VAO и текстуры привязываются только через тень состояния;
+    // настройка выше меняла их напрямую, поэтому тень создаётся здесь пустой
+    GlState glState;
+
+    if (benchmark) {
+        // Замеры идут с настоящими текстурами
+        while (textures.getPendingCount() > 0) {
+            textures.update();
+            std::this_thread::yield();
+        }
+        bindTextures(glState);
+        window.setVerticalSyncEnabled(false);
+        runBenchmark(window, glState, shaderProgram, instancedProgram, VAO, instancedVAO, indexCount, frameUniforms, objectUniforms,
+                     instanceBuffer, materialCount);
+        return EXIT_SUCCESS;
+    }
+
+    // Кластерное освещение: границы кластеров зависят от проекции и
+    // пересчитываются вместе с камерой, списки источников - каждый кадр
+    std::unique_ptr<ClusteredLights> clusters;
+    std::vector<PointLight> baseLights, lights;
+    if (lightCount > 0) {
+        clusters = std::make_unique<ClusteredLights>(jobs);
+        baseLights = makeLights(lightCount, instanceCount);
+    }
+    auto applyCamera = [&](std::size_t count) {
+        FrameUniforms& frame = frameUniforms.edit();
+        setCamera(frame, count);
+        if (clusters) {
+            clusters->setProjection(frame.projection, 800.0f, 600.0f);
+            frame.clusterScale = clusters->getClusterScale();
+        }
+    };
+
+    bool instanced = false;
+    std::string title = "lab4";
+    applyCamera(0);
+    if (clusters) {
+        animateLights(baseLights, lights, 0.0f);
+        const int runs = 10;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run)
+            clusters->update(lights, frameUniforms.get().view);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "lights: " << lights.size() << ", clusters: " << ClusteredLights::gridX << "x" << ClusteredLights::gridY
+                  << "x" << ClusteredLights::gridZ << ", lights per cluster: " << clusters->getAverageListLength() << " (max "
+                  << clusters->getMaxListLength() << "), assignment: " << elapsed.count() / runs << " ms" << std::endl;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point titleTime;
+    std::vector<InstanceData> instances;
     float rotationX = 0.0f;
     float rotationY = 0.0f;
 
     // Основной цикл
-    bool useNormalMap = true; // Флаг для переключения
+    bool rotated = true;
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -264,61 +673,71 @@ int main() {
             } else if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::Space) {
                     useNormalMap = !useNormalMap; // Переключение по пробелу
+                    frameUniforms.edit().useNormalMap = useNormalMap;
+                } else if (event.key.code == sf::Keyboard::I) {
+                    instanced = !instanced;
+                    applyCamera(instanced ? instanceCount : 0);
+                    rotated = true;
+                    title = instanced ? "lab4 - " + std::to_string(instanceCount) + " instances" : std::string("lab4");
+                    titleTime = std::chrono::steady_clock::time_point();
                 } else if (event.key.code == sf::Keyboard::Up) {
                     rotationX -= 5.0f; // Поворот вверх
+                    rotated = true;
                 } else if (event.key.code == sf::Keyboard::Down) {
                     rotationX += 5.0f; // Поворот вниз
+                    rotated = true;
                 } else if (event.key.code == sf::Keyboard::Left) {
                     rotationY -= 5.0f; // Поворот влево
+                    rotated = true;
                 } else if (event.key.code == sf::Keyboard::Right) {
                     rotationY += 5.0f; // Поворот вправо
+                    rotated = true;
                 }
             }
         }
 
+        // Обновление модельных матриц только после поворота
+        if (rotated) {
+            if (instanced) {
+                fillInstanceGrid(instances, instanceCount, rotationX, rotationY, materialCount);
+            } else {
+                objectUniforms.edit() = makeObjectUniforms(makeInstance(cubeRotation(rotationX, rotationY)));
+            }
+            rotated = false;
+        }
+        // Раз в секунду в заголовке - вызовы состояния GL за прошлый кадр
+        glState.beginFrame();
+        auto now = std::chrono::steady_clock::now();
+        if (now - titleTime >= std::chrono::seconds(1)) {
+            const GlState::Counters& calls = glState.getLastFrame();
+            window.setTitle(title + " - GL state calls: " + std::to_string(calls.issued) + " issued, " +
+                            std::to_string(calls.elided) + " elided");
+            titleTime = now;
+        }
+
+        frameUniforms.upload();
+        objectUniforms.upload();
+        if (textures.update())
+            glState.invalidateTextures();
+        bindTextures(glState);
+        if (clusters) {
+            std::chrono::duration<float> time = now - startTime;
+            animateLights(baseLights, lights, time.count());
+            clusters->update(lights, frameUniforms.get().view);
+            clusters->bind(glState, lightTextureUnit);
+        }
+
         // Очистка буфера цвета и глубины
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Использование шейдеров
-        glUseProgram(shaderProgram);
-
-        // Обновление модельной матрицы
-        model = glm::rotate(glm::mat4(1.0f), glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
-
-        // Установка униформов шейдеров
-        GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-        GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-        GLint lightPosLoc = glGetUniformLocation(shaderProgram, "lightPos");
-        GLint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
-        GLint texture1Loc = glGetUniformLocation(shaderProgram, "texture1");
-        GLint normalMapLoc = glGetUniformLocation(shaderProgram, "normalMap");
-        GLint useNormalMapLoc = glGetUniformLocation(shaderProgram, "useNormalMap");
-
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Установка позиций света и камеры
-        glUniform3f(lightPosLoc, 1.2f, 1.0f, 2.0f);
-        glUniform3f(viewPosLoc, 0.0f, 0.0f, 3.0f);
-
-        // Установка использования нормальной карты
-        glUniform1i(useNormalMapLoc, useNormalMap);
-
-        // Активизация текстур
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glUniform1i(texture1Loc, 0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMap);
-        glUniform1i(normalMapLoc, 1);
-
-        // Отрисовка куба
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        // Отрисовка куба или сетки экземпляров
+        if (instanced) {
+            drawInstanced(glState, instances, instancedProgram, instancedVAO, indexCount, instanceBuffer);
+        } else {
+            shaderProgram.use(glState);
+            glState.bindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+        }
 
         window.display();
     }
@@ -0,0 +1,191 @@
+#pragma once
+#include <GL/glew.h>
+#include <SFML/Graphics.hpp>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../common/job_system.hpp"
+#include "texture_container.hpp"
+
+// Материал: альбедо, умноженное на tint, и карта нормалей (пустой путь - плоская)
+struct MaterialDesc {
+    std::string albedoPath;
+    std::string normalPath;
+    glm::vec3 tint = glm::vec3(1.0f);
+};
+
+// Материалы в двух массивах текстур GL_TEXTURE_2D_ARRAY (альбедо и нормали),
+// слой массива = номер материала. Шейдер (MATERIAL_ARRAYS) берёт слой из
+// атрибута экземпляра, так что кубы с разными материалами рисуются одним
+// вызовом без перепривязки текстур. Все слои одного размера: у каждого
+// исходника в мип-цепочке должен быть уровень этого размера.
+class MaterialArrays {
+public:
+    MaterialArrays() = default;
+
+    ~MaterialArrays() {
+        if (albedo)
+            glDeleteTextures(1, &albedo);
+        if (normals)
+            glDeleteTextures(1, &normals);
+    }
+
+    MaterialArrays(const MaterialArrays&) = delete;
+    MaterialArrays& operator=(const MaterialArrays&) = delete;
+
+    // Слои размером с первый уровень альбедо первого материала, не больше maxSize по большей стороне.
+    // Исходники декодируются, а слои тонируются в рабочих потоках; загрузка в GL - в вызывающем.
+    bool build(JobSystem& jobs, const std::vector<MaterialDesc>& materials, int maxSize) {
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if (materials.empty() || static_cast<GLint>(materials.size()) > maxLayers) {
+            std::cerr << "Material count must be 1.." << maxLayers << std::endl;
+            return false;
+        }
+
+        // Каждый файл декодируется один раз, сколько бы материалов его ни использовали
+        std::map<std::string, std::vector<MipLevel>> sources;
+        for (const MaterialDesc& material : materials) {
+            sources[material.albedoPath];
+            if (!material.normalPath.empty())
+                sources[material.normalPath];
+        }
+        std::vector<std::pair<const std::string, std::vector<MipLevel>>*> pending;
+        for (auto& source : sources)
+            pending.push_back(&source);
+        jobs.parallelFor(pending.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                sf::Image image;
+                if (image.loadFromFile(pending[i]->first))
+                    pending[i]->second = buildMipChain(image.getPixelsPtr(), static_cast<int>(image.getSize().x),
+                                                       static_cast<int>(image.getSize().y));
+            }
+        });
+
+        // Общий размер слоя и первый подходящий уровень каждого исходника
+        const std::vector<MipLevel>& first = sources[materials[0].albedoPath];
+        if (first.empty()) {
+            std::cerr << "Failed to load texture " << materials[0].albedoPath << std::endl;
+            return false;
+        }
+        std::size_t firstLevel = 0;
+        while (std::max(first[firstLevel].width, first[firstLevel].height) > maxSize && firstLevel + 1 < first.size())
+            ++firstLevel;
+        width = first[firstLevel].width;
+        height = first[firstLevel].height;
+        levelCount = static_cast<int>(first.size() - firstLevel);
+        std::map<std::string, std::size_t> baseLevels;
+        for (const auto& source : sources) {
+            if (source.second.empty()) {
+                std::cerr << "Failed to load texture " << source.first << std::endl;
+                return false;
+            }
+            auto level = std::find_if(source.second.begin(), source.second.end(),
+                                      [&](const MipLevel& l) { return l.width == width && l.height == height; });
+            if (level == source.second.end()) {
+                std::cerr << "Texture " << source.first << " has no " << width << "x" << height << " level" << std::endl;
+                return false;
+            }
+            baseLevels[source.first] = static_cast<std::size_t>(level - source.second.begin());
+        }
+
+        layerCount = static_cast<GLsizei>(materials.size());
+        albedo = allocate();
+        normals = allocate();
+
+        // Тонирование по материалам параллельно, загрузка слоями
+        std::vector<std::vector<MipLevel>> tinted(materials.size());
+        jobs.parallelFor(materials.size(), 16, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const std::vector<MipLevel>& source = sources.at(materials[i].albedoPath);
+                std::size_t base = baseLevels.at(materials[i].albedoPath);
+                tinted[i].assign(source.begin() + base, source.begin() + base + levelCount);
+                tint(tinted[i], materials[i].tint);
+            }
+        });
+        std::vector<MipLevel> flat = flatNormals();
+        for (std::size_t i = 0; i < materials.size(); ++i) {
+            upload(albedo, static_cast<GLint>(i), tinted[i].data());
+            const std::string& normalPath = materials[i].normalPath;
+            upload(normals, static_cast<GLint>(i),
+                   normalPath.empty() ? flat.data() : sources.at(normalPath).data() + baseLevels.at(normalPath));
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return true;
+    }
+
+    GLuint getAlbedo() const { return albedo; }
+    GLuint getNormals() const { return normals; }
+    GLsizei getLayerCount() const { return layerCount; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Память обоих массивов со всеми уровнями
+    std::size_t getBytes() const {
+        std::size_t bytes = 0;
+        for (int level = 0; level < levelCount; ++level)
+            bytes += static_cast<std::size_t>(std::max(1, width >> level)) * std::max(1, height >> level) * 4;
+        return bytes * layerCount * 2;
+    }
+
+private:
+    GLuint albedo = 0;
+    GLuint normals = 0;
+    GLsizei layerCount = 0;
+    int width = 0;
+    int height = 0;
+    int levelCount = 0;
+
+    GLuint allocate() const {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        for (int level = 0; level < levelCount; ++level) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1, width >> level), std::max(1, height >> level),
+                         layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    // Все уровни одного слоя; levels - цепочка, начинающаяся с размера слоя
+    void upload(GLuint texture, GLint layer, const MipLevel* levels) const {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        for (int level = 0; level < levelCount; ++level) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levels[level].width, levels[level].height, 1, GL_RGBA,
+                            GL_UNSIGNED_BYTE, levels[level].pixels.data());
+        }
+    }
+
+    // Усреднение и умножение на цвет перестановочны, поэтому тонируется готовая цепочка
+    static void tint(std::vector<MipLevel>& levels, const glm::vec3& color) {
+        for (MipLevel& level : levels) {
+            for (std::size_t i = 0; i < level.pixels.size(); i += 4) {
+                for (int c = 0; c < 3; ++c)
+                    level.pixels[i + c] = static_cast<unsigned char>(std::min(255.0f, level.pixels[i + c] * color[c] + 0.5f));
+            }
+        }
+    }
+
+    std::vector<MipLevel> flatNormals() const {
+        std::vector<MipLevel> levels(levelCount);
+        for (int i = 0; i < levelCount; ++i) {
+            levels[i].width = std::max(1, width >> i);
+            levels[i].height = std::max(1, height >> i);
+            levels[i].pixels.resize(static_cast<std::size_t>(levels[i].width) * levels[i].height * 4);
+            for (std::size_t p = 0; p < levels[i].pixels.size(); p += 4) {
+                levels[i].pixels[p] = 128;
+                levels[i].pixels[p + 1] = 128;
+                levels[i].pixels[p + 2] = 255;
+                levels[i].pixels[p + 3] = 255;
+            }
+        }
+        return levels;
+    }
+};
@@ -0,0 +1,392 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Структура вершины
+struct Vertex {
+    GLfloat position[3];
+    GLfloat texCoord[2];
+    GLfloat normal[3];
+    GLfloat tangent[3];
+    GLfloat bitangent[3];
+};
+
+// Индексированная сетка треугольников
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+// Склейка одинаковых вершин "супа" треугольников (по три вершины подряд).
+// Сравниваются позиция, текстурные координаты и нормаль; касательные
+// не учитываются, их заново считает generateTangents().
+inline MeshData weldVertices(const Vertex* soup, std::size_t count) {
+    struct Key {
+        GLfloat values[8];
+        bool operator==(const Key& other) const { return std::memcmp(values, other.values, sizeof(values)) == 0; }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            std::size_t hash = 14695981039346656037ull;
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key.values);
+            for (std::size_t i = 0; i < sizeof(key.values); ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    MeshData mesh;
+    std::unordered_map<Key, GLuint, KeyHash> unique;
+    mesh.indices.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const Vertex& v = soup[i];
+        // +0.0f превращает -0.0f в 0.0f, чтобы побайтовое сравнение их не различало
+        Key key = {{v.position[0] + 0.0f, v.position[1] + 0.0f, v.position[2] + 0.0f, v.texCoord[0] + 0.0f,
+                     v.texCoord[1] + 0.0f, v.normal[0] + 0.0f, v.normal[1] + 0.0f, v.normal[2] + 0.0f}};
+        auto inserted = unique.emplace(key, static_cast<GLuint>(mesh.vertices.size()));
+        if (inserted.second)
+            mesh.vertices.push_back(v);
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// Загрузка OBJ: v, vt, vn и многоугольные f (веером в треугольники), в том числе
+// отрицательные индексы. Одинаковые тройки v/vt/vn становятся одной вершиной.
+// Без vn нормали сглаживаются по всем граням, сходящимся в позиции.
+inline bool loadObj(const std::string& path, MeshData& mesh) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    struct Corner {
+        int position, texCoord, normal;
+    };
+    struct CornerHash {
+        std::size_t operator()(const Corner& c) const {
+            return (static_cast<std::size_t>(c.position) * 73856093u) ^ (static_cast<std::size_t>(c.texCoord) * 19349663u)
+                 ^ (static_cast<std::size_t>(c.normal) * 83492791u);
+        }
+    };
+    struct CornerEqual {
+        bool operator()(const Corner& a, const Corner& b) const {
+            return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+        }
+    };
+    std::unordered_map<Corner, GLuint, CornerHash, CornerEqual> unique;
+    std::vector<int> vertexPositions;
+
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    bool hasNormals = true;
+    // Индекс OBJ начинается с 1, отрицательный отсчитывается от конца; -1 - нет индекса
+    auto resolve = [](const std::string& token, std::size_t count) {
+        if (token.empty())
+            return -1;
+        int index = std::atoi(token.c_str());
+        index = index < 0 ? static_cast<int>(count) + index : index - 1;
+        return index >= 0 && index < static_cast<int>(count) ? index : -1;
+    };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+        if (type == "v") {
+            glm::vec3 p;
+            stream >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        } else if (type == "vt") {
+            glm::vec2 t;
+            stream >> t.x >> t.y;
+            texCoords.push_back(t);
+        } else if (type == "vn") {
+            glm::vec3 n;
+            stream >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        } else if (type == "f") {
+            std::vector<GLuint> polygon;
+            std::string token;
+            while (stream >> token) {
+                std::string parts[3];
+                std::size_t part = 0;
+                for (char c : token) {
+                    if (c == '/') {
+                        if (++part > 2)
+                            break;
+                    } else {
+                        parts[part] += c;
+                    }
+                }
+                Corner corner = {resolve(parts[0], positions.size()), resolve(parts[1], texCoords.size()),
+                                 resolve(parts[2], normals.size())};
+                if (corner.position < 0)
+                    return false;
+                if (corner.normal < 0)
+                    hasNormals = false;
+                auto inserted = unique.emplace(corner, static_cast<GLuint>(mesh.vertices.size()));
+                if (inserted.second) {
+                    Vertex v = {};
+                    glm::vec3 p = positions[corner.position];
+                    v.position[0] = p.x, v.position[1] = p.y, v.position[2] = p.z;
+                    if (corner.texCoord >= 0)
+                        v.texCoord[0] = texCoords[corner.texCoord].x, v.texCoord[1] = texCoords[corner.texCoord].y;
+                    if (corner.normal >= 0) {
+                        glm::vec3 n = normals[corner.normal];
+                        v.normal[0] = n.x, v.normal[1] = n.y, v.normal[2] = n.z;
+                    }
+                    mesh.vertices.push_back(v);
+                    vertexPositions.push_back(corner.position);
+                }
+                polygon.push_back(inserted.first->second);
+            }
+            for (std::size_t i = 2; i < polygon.size(); ++i)
+                mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+        }
+    }
+    if (mesh.indices.empty())
+        return false;
+
+    if (!hasNormals) {
+        // Сумма ненормированных нормалей граней взвешивает их по площади
+        std::vector<glm::vec3> accumulated(positions.size(), glm::vec3(0.0f));
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const GLuint* tri = &mesh.indices[i];
+            glm::vec3 p0 = positions[vertexPositions[tri[0]]];
+            glm::vec3 p1 = positions[vertexPositions[tri[1]]];
+            glm::vec3 p2 = positions[vertexPositions[tri[2]]];
+            glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            for (int k = 0; k < 3; ++k)
+                accumulated[vertexPositions[tri[k]]] += faceNormal;
+        }
+        for (std::size_t i = 0; i < mesh.vertices.size(); ++i) {
+            glm::vec3 n = accumulated[vertexPositions[i]];
+            n = glm::length(n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 1.0f, 0.0f);
+            Vertex& v = mesh.vertices[i];
+            v.normal[0] = n.x, v.normal[1] = n.y, v.normal[2] = n.z;
+        }
+    }
+    return true;
+}
+
+// Масштаб и сдвиг сетки в куб [-1, 1]^3 с сохранением пропорций
+inline void fitToUnitCube(MeshData& mesh) {
+    if (mesh.vertices.empty())
+        return;
+    glm::vec3 lo(mesh.vertices[0].position[0], mesh.vertices[0].position[1], mesh.vertices[0].position[2]);
+    glm::vec3 hi = lo;
+    for (const Vertex& v : mesh.vertices) {
+        glm::vec3 p(v.position[0], v.position[1], v.position[2]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    glm::vec3 extent = (hi - lo) * 0.5f;
+    float scale = std::max(extent.x, std::max(extent.y, extent.z));
+    scale = scale > 0.0f ? 1.0f / scale : 1.0f;
+    for (Vertex& v : mesh.vertices) {
+        for (int k = 0; k < 3; ++k)
+            v.position[k] = (v.position[k] - center[k]) * scale;
+    }
+}
+
+// Касательные по производным текстурных координат треугольников, сумма по
+// вершине, ортогонализация к нормали (Грам-Шмидт). Битангента = cross(N, T)
+// со знаком, который задаёт направление v в текстуре (зеркальные развёртки).
+inline void generateTangents(MeshData& mesh) {
+    std::vector<glm::vec3> tangents(mesh.vertices.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(mesh.vertices.size(), glm::vec3(0.0f));
+    for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const Vertex* v[3] = {&mesh.vertices[mesh.indices[i]], &mesh.vertices[mesh.indices[i + 1]],
+                              &mesh.vertices[mesh.indices[i + 2]]};
+        glm::vec3 p0(v[0]->position[0], v[0]->position[1], v[0]->position[2]);
+        glm::vec3 e1 = glm::vec3(v[1]->position[0], v[1]->position[1], v[1]->position[2]) - p0;
+        glm::vec3 e2 = glm::vec3(v[2]->position[0], v[2]->position[1], v[2]->position[2]) - p0;
+        float du1 = v[1]->texCoord[0] - v[0]->texCoord[0], dv1 = v[1]->texCoord[1] - v[0]->texCoord[1];
+        float du2 = v[2]->texCoord[0] - v[0]->texCoord[0], dv2 = v[2]->texCoord[1] - v[0]->texCoord[1];
+        float det = du1 * dv2 - du2 * dv1;
+        if (std::fabs(det) < 1e-12f)
+            continue;
+        // Без деления на det: вклад треугольника пропорционален его площади в развёртке
+        float sign = det > 0.0f ? 1.0f : -1.0f;
+        glm::vec3 t = (e1 * dv2 - e2 * dv1) * sign;
+        glm::vec3 b = (e2 * du1 - e1 * du2) * sign;
+        for (int k = 0; k < 3; ++k) {
+            tangents[mesh.indices[i + k]] += t;
+            bitangents[mesh.indices[i + k]] += b;
+        }
+    }
+
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i) {
+        Vertex& v = mesh.vertices[i];
+        glm::vec3 n(v.normal[0], v.normal[1], v.normal[2]);
+        glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+        if (glm::length(t) < 1e-6f) {
+            // Нет развёртки: любая касательная, перпендикулярная нормали
+            t = glm::cross(std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f), n);
+        }
+        t = glm::normalize(t);
+        float handedness = glm::dot(glm::cross(n, t), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+        glm::vec3 b = glm::cross(n, t) * handedness;
+        for (int k = 0; k < 3; ++k) {
+            v.tangent[k] = t[k];
+            v.bitangent[k] = b[k];
+        }
+    }
+}
+
+// Доля промахов FIFO-кэша вершин на треугольник (ACMR): 0.5 - идеал для
+// регулярных сеток, 3 - каждая вершина выбирается заново
+inline float averageCacheMissRatio(const std::vector<GLuint>& indices, std::size_t vertexCount, unsigned cacheSize = 16) {
+    if (indices.size() < 3)
+        return 0.0f;
+    std::vector<unsigned> timestamps(vertexCount, 0);
+    unsigned time = cacheSize + 1, misses = 0;
+    for (GLuint index : indices) {
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            ++misses;
+        }
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+// Перестановка треугольников под кэш вершин после преобразования
+// (алгоритм Т. Форсайта): жадно выбирается треугольник с наибольшей суммой
+// оценок вершин, где оценка растёт для недавно использованных вершин и для
+// вершин с малым числом оставшихся треугольников.
+inline void optimizeVertexCache(std::vector<GLuint>& indices, std::size_t vertexCount) {
+    const int cacheSize = 32;
+    const std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [](int cachePosition, int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // Вершины только что выданного треугольника не поощряются сильнее прочих
+            score = cachePosition < 3 ? 0.75f
+                                      : std::pow(1.0f - (cachePosition - 3) / static_cast<float>(cacheSize - 3), 1.5f);
+        }
+        return score + 2.0f * std::pow(static_cast<float>(remaining), -0.5f);
+    };
+
+    // Смежность вершина -> треугольники в сжатом виде
+    std::vector<int> remaining(vertexCount, 0), adjacencyStart(vertexCount + 1, 0), adjacency(indices.size());
+    for (GLuint index : indices)
+        ++remaining[index];
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = static_cast<int>(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    for (std::size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    std::vector<int> cache, nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+    std::size_t scanCursor = 0;
+    int best = static_cast<int>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+    while (best >= 0) {
+        emitted[best] = 1;
+        const GLuint* tri = &indices[best * 3];
+        result.insert(result.end(), tri, tri + 3);
+
+        // Вершины треугольника в начало LRU-кэша, треугольник убирается из их смежности
+        nextCache.assign(tri, tri + 3);
+        for (int v : cache) {
+            if (v != static_cast<int>(tri[0]) && v != static_cast<int>(tri[1]) && v != static_cast<int>(tri[2]))
+                nextCache.push_back(v);
+        }
+        for (int k = 0; k < 3; ++k) {
+            int v = tri[k];
+            int* begin = &adjacency[adjacencyStart[v]];
+            int* end = begin + remaining[v];
+            *std::find(begin, end, best) = *(end - 1);
+            --remaining[v];
+        }
+
+        // Пересчёт оценок кэша; лучший следующий ищется среди соседей кэша
+        for (std::size_t i = 0; i < nextCache.size(); ++i) {
+            int v = nextCache[i];
+            cachePosition[v] = i < static_cast<std::size_t>(cacheSize) ? static_cast<int>(i) : -1;
+            float updated = vertexScore(cachePosition[v], remaining[v]);
+            float delta = updated - score[v];
+            score[v] = updated;
+            for (int a = adjacencyStart[v]; a < adjacencyStart[v] + remaining[v]; ++a)
+                triangleScore[adjacency[a]] += delta;
+        }
+        if (nextCache.size() > static_cast<std::size_t>(cacheSize))
+            nextCache.resize(cacheSize);
+        std::swap(cache, nextCache);
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (int v : cache) {
+            for (int a = adjacencyStart[v]; a < adjacencyStart[v] + remaining[v]; ++a) {
+                int t = adjacency[a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        // Кэш исчерпан: следующий ещё не выданный треугольник по порядку
+        if (best < 0) {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                ++scanCursor;
+            if (scanCursor < triangleCount)
+                best = static_cast<int>(scanCursor);
+        }
+    }
+    indices.swap(result);
+}
+
+// Перенумерация вершин в порядке первого использования: выборка вершин
+// идёт по памяти почти последовательно
+inline void optimizeVertexFetch(MeshData& mesh) {
+    std::vector<GLuint> remap(mesh.vertices.size(), ~0u);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (GLuint& index : mesh.indices) {
+        if (remap[index] == ~0u) {
+            remap[index] = static_cast<GLuint>(ordered.size());
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(ordered);
+}
+
+// Полная подготовка загруженной сетки к отрисовке через glDrawElements
+inline void prepareMesh(MeshData& mesh) {
+    generateTangents(mesh);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeVertexFetch(mesh);
+}
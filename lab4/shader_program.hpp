@@ -0,0 +1,162 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/gl_utils.hpp"
+#include "../common/program_cache.hpp"
+#include "gl_state.hpp"
+
+// Создание шейдерной программы. С кэшем программа сначала ищется среди
+// сохранённых образов и компилируется, только если образа нет или он не подошёл.
+inline GLuint createProgram(const char* vertexSource, const char* fragmentSource, ProgramCache* cache) {
+    GLuint program = glCreateProgram();
+    std::uint64_t key = 0;
+    if (cache && cache->isSupported()) {
+        key = cache->makeKey({vertexSource, fragmentSource});
+        if (cache->load(program, key))
+            return program;
+        cache->prepare(program);
+    }
+    if (linkShaders(program, vertexSource, fragmentSource) && cache)
+        cache->store(program, key);
+    return program;
+}
+
+// Вставка строк "#define ..." сразу после "#version" (он обязан быть первым)
+inline std::string withDefines(const char* source, const std::string& defines) {
+    std::string text = source;
+    if (defines.empty())
+        return text;
+    std::size_t version = text.find("#version");
+    std::size_t lineEnd = version == std::string::npos ? std::string::npos : text.find('\n', version);
+    std::size_t insertAt = lineEnd == std::string::npos ? 0 : lineEnd + 1;
+    return text.insert(insertAt, defines);
+}
+
+// Шейдерная программа с таблицей активных uniform-переменных, прочитанной
+// один раз после компоновки: в цикле отрисовки нет glGetUniformLocation.
+class ShaderProgram {
+public:
+    // defines - строки вида "#define NAME\n", добавляются в оба шейдера
+    ShaderProgram(const char* vertexSource, const char* fragmentSource, const std::string& defines = "",
+                  ProgramCache* cache = nullptr)
+        : program(createProgram(withDefines(vertexSource, defines).c_str(), withDefines(fragmentSource, defines).c_str(), cache)) {
+        reflectUniforms();
+    }
+
+    ~ShaderProgram() { glDeleteProgram(program); }
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    GLuint getHandle() const { return program; }
+
+    void use() const { glUseProgram(program); }
+
+    // В цикле отрисовки: через тень состояния, повторный glUseProgram пропускается
+    void use(GlState& state) const { state.useProgram(program); }
+
+    // -1, если переменной нет или компилятор её выбросил (glUniform* такое игнорирует)
+    GLint location(const std::string& name) const {
+        auto found = locations.find(name);
+        return found != locations.end() ? found->second : -1;
+    }
+
+    bool hasUniform(const std::string& name) const { return locations.count(name) != 0; }
+
+    // Привязка uniform-блока к точке привязки буфера; false, если блока нет
+    bool bindUniformBlock(const char* name, GLuint binding) const {
+        GLuint index = glGetUniformBlockIndex(program, name);
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(program, index, binding);
+        return true;
+    }
+
+    // Номер текстурного блока для сэмплера; задаётся один раз, программа становится текущей
+    void setSampler(const std::string& name, GLint unit) const {
+        use();
+        glUniform1i(location(name), unit);
+    }
+
+    // Постоянный параметр, задаётся один раз; программа становится текущей
+    void setVector(const std::string& name, float x, float y, float z, float w) const {
+        use();
+        glUniform4f(location(name), x, y, z, w);
+    }
+
+private:
+    GLuint program;
+    std::unordered_map<std::string, GLint> locations;
+
+    void reflectUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i) {
+            GLint size = 0;
+            GLenum type = 0;
+            GLsizei length = 0;
+            glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            // Члены uniform-блоков не имеют расположения, их задаёт буфер
+            GLint uniformLocation = glGetUniformLocation(program, uniformName.c_str());
+            if (uniformLocation < 0)
+                continue;
+            // Массивы отдаются как "name[0]"; доступны и под именем без индекса
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                locations[uniformName.substr(0, uniformName.size() - 3)] = uniformLocation;
+            locations[uniformName] = uniformLocation;
+        }
+    }
+};
+
+// Uniform-буфер с раскладкой std140 для структуры T. Изменения через edit()
+// помечают буфер грязным, upload() отправляет его в GL только после изменений.
+// Поля T должны повторять std140: vec3 занимает 16 байт, mat4 - 64.
+template <typename T>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    ~UniformBuffer() { glDeleteBuffers(1, &buffer); }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    GLuint getBinding() const { return binding; }
+
+    const T& get() const { return data; }
+
+    T& edit() {
+        dirty = true;
+        return data;
+    }
+
+    // true, если данные были отправлены
+    bool upload() {
+        if (!dirty)
+            return false;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        dirty = false;
+        return true;
+    }
+
+private:
+    GLuint binding;
+    GLuint buffer = 0;
+    T data{};
+    bool dirty = true;
+};
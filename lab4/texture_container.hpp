@@ -0,0 +1,389 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Уровень мип-цепочки в RGBA8, строки подряд без выравнивания
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Мип-цепочка до 1x1 усреднением блоков 2x2 (на нечётной стороне последний
+// столбец/строка берутся дважды)
+inline std::vector<MipLevel> buildMipChain(const unsigned char* rgba, int width, int height) {
+    std::vector<MipLevel> levels(1);
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].pixels.assign(rgba, rgba + static_cast<std::size_t>(width) * height * 4);
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const MipLevel& source = levels.back();
+        MipLevel level;
+        level.width = std::max(1, source.width / 2);
+        level.height = std::max(1, source.height / 2);
+        level.pixels.resize(static_cast<std::size_t>(level.width) * level.height * 4);
+        for (int y = 0; y < level.height; ++y) {
+            int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            for (int x = 0; x < level.width; ++x) {
+                int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                for (int c = 0; c < 4; ++c) {
+                    auto at = [&](int sx, int sy) { return source.pixels[(static_cast<std::size_t>(sy) * source.width + sx) * 4 + c]; };
+                    int sum = at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1);
+                    level.pixels[(static_cast<std::size_t>(y) * level.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+
+// Формат файла текстуры (.tex): заголовок, таблица уровней, данные уровней
+// с выравниванием на 16 байт. Уровни уже в формате GL и грузятся прямо из
+// отображённого в память файла.
+enum class TextureFormat : std::uint32_t {
+    Rgba8 = 0,
+    Bc1 = 1,   // GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8 байт на блок 4x4
+    Bc5 = 2,   // GL_COMPRESSED_RG_RGTC2, 16 байт на блок; карты нормалей (X, Y)
+};
+
+struct TextureFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levelCount;
+};
+
+struct TextureFileLevel {
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+constexpr char textureFileMagic[4] = {'L', 'T', 'E', 'X'};
+constexpr std::uint32_t textureFileVersion = 1;
+
+inline const char* textureFormatName(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::Bc1: return "BC1";
+        case TextureFormat::Bc5: return "BC5";
+        default: return "RGBA8";
+    }
+}
+
+// Размер уровня width x height в байтах: 4 на пиксель для RGBA8, 8 или 16 на
+// блок 4x4 (неполные блоки на краях считаются целыми) для BC1 и BC5
+inline std::uint64_t textureLevelBytes(TextureFormat format, std::uint32_t width, std::uint32_t height) {
+    if (format == TextureFormat::Rgba8)
+        return static_cast<std::uint64_t>(width) * height * 4;
+    const std::uint64_t blocks = static_cast<std::uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == TextureFormat::Bc1 ? 8 : 16);
+}
+
+// Блок 4x4 RGBA8 с повтором крайних пикселей для уровней меньше 4x4
+inline void fetchBlock(const MipLevel& level, int blockX, int blockY, unsigned char block[16][4]) {
+    for (int y = 0; y < 4; ++y) {
+        int sy = std::min(blockY * 4 + y, level.height - 1);
+        for (int x = 0; x < 4; ++x) {
+            int sx = std::min(blockX * 4 + x, level.width - 1);
+            std::memcpy(block[y * 4 + x], &level.pixels[(static_cast<std::size_t>(sy) * level.width + sx) * 4], 4);
+        }
+    }
+}
+
+// BC1 без альфы: концы отрезка - диагональ рамки цветов блока, сжатой на 1/16
+// внутрь (быстрый вариант по ван Вэверену); из четырёх диагоналей берётся
+// та, что идёт по знаку ковариации R и B с G. Индексы - ближайший из четырёх цветов.
+inline void encodeBc1Block(const unsigned char block[16][4], unsigned char out[8]) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], static_cast<int>(block[i][c]));
+            hi[c] = std::max(hi[c], static_cast<int>(block[i][c]));
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] = std::min(255, lo[c] + inset);
+        hi[c] = std::max(0, hi[c] - inset);
+    }
+    int mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c)
+            mean[c] += block[i][c];
+    }
+    int covariance[3] = {0, 0, 0};
+    for (int i = 0; i < 16; ++i) {
+        int dg = block[i][1] * 16 - mean[1];
+        for (int c = 0; c < 3; c += 2)
+            covariance[c] += (block[i][c] * 16 - mean[c]) * dg;
+    }
+    for (int c = 0; c < 3; c += 2) {
+        if (covariance[c] < 0)
+            std::swap(lo[c], hi[c]);
+    }
+    auto to565 = [](const int rgb[3]) {
+        return static_cast<std::uint16_t>(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+    };
+    std::uint16_t color0 = to565(hi), color1 = to565(lo);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    // Палитра по уже округлённым концам, как её увидит декодер
+    int palette[4][3];
+    for (int k = 0; k < 2; ++k) {
+        std::uint16_t color = k == 0 ? color0 : color1;
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        palette[k][0] = (r << 3) | (r >> 2);
+        palette[k][1] = (g << 2) | (g >> 4);
+        palette[k][2] = (b << 3) | (b >> 2);
+    }
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    std::uint32_t indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDistance = 1 << 30;
+            for (int k = 0; k < 4; ++k) {
+                int distance = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int d = block[i][c] - palette[k][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = k;
+                }
+            }
+            indices |= static_cast<std::uint32_t>(best) << (i * 2);
+        }
+    }
+    out[0] = color0 & 0xff, out[1] = color0 >> 8;
+    out[2] = color1 & 0xff, out[3] = color1 >> 8;
+    for (int k = 0; k < 4; ++k)
+        out[4 + k] = (indices >> (k * 8)) & 0xff;
+}
+
+// BC4 для одного канала: концы - минимум и максимум, восемь ступеней
+inline void encodeBc4Block(const unsigned char block[16][4], int channel, unsigned char out[8]) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, static_cast<int>(block[i][channel]));
+        hi = std::max(hi, static_cast<int>(block[i][channel]));
+    }
+    out[0] = static_cast<unsigned char>(hi);
+    out[1] = static_cast<unsigned char>(lo);
+    std::uint64_t indices = 0;
+    if (hi > lo) {
+        for (int i = 0; i < 16; ++i) {
+            // Ступень 0 - hi, 7 - lo; в BC4 им соответствуют индексы 0 и 1, ступени 1..6 - индексы 2..7
+            int step = ((hi - block[i][channel]) * 7 + (hi - lo) / 2) / (hi - lo);
+            int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= static_cast<std::uint64_t>(index) << (i * 3);
+        }
+    }
+    for (int k = 0; k < 6; ++k)
+        out[2 + k] = (indices >> (k * 8)) & 0xff;
+}
+
+// Данные уровня в формате контейнера
+inline std::vector<unsigned char> encodeLevel(const MipLevel& level, TextureFormat format) {
+    if (format == TextureFormat::Rgba8)
+        return level.pixels;
+    const int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+    const std::size_t blockSize = format == TextureFormat::Bc1 ? 8 : 16;
+    std::vector<unsigned char> data(static_cast<std::size_t>(blocksX) * blocksY * blockSize);
+    unsigned char block[16][4];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            fetchBlock(level, bx, by, block);
+            unsigned char* out = &data[(static_cast<std::size_t>(by) * blocksX + bx) * blockSize];
+            if (format == TextureFormat::Bc1) {
+                encodeBc1Block(block, out);
+            } else {
+                encodeBc4Block(block, 0, out);
+                encodeBc4Block(block, 1, out + 8);
+            }
+        }
+    }
+    return data;
+}
+
+// Запись контейнера; levels - полная мип-цепочка из buildMipChain()
+inline bool writeTextureFile(const std::string& path, const std::vector<MipLevel>& levels, TextureFormat format) {
+    std::vector<std::vector<unsigned char>> encoded;
+    for (const MipLevel& level : levels)
+        encoded.push_back(encodeLevel(level, format));
+
+    TextureFileHeader header = {};
+    std::memcpy(header.magic, textureFileMagic, 4);
+    header.version = textureFileVersion;
+    header.format = static_cast<std::uint32_t>(format);
+    header.width = levels.empty() ? 0 : levels[0].width;
+    header.height = levels.empty() ? 0 : levels[0].height;
+    header.levelCount = static_cast<std::uint32_t>(levels.size());
+
+    std::vector<TextureFileLevel> table(levels.size());
+    std::uint64_t offset = sizeof(header) + table.size() * sizeof(TextureFileLevel);
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        offset = (offset + 15) & ~std::uint64_t(15);
+        table[i] = {static_cast<std::uint32_t>(levels[i].width), static_cast<std::uint32_t>(levels[i].height), offset, encoded[i].size()};
+        offset += encoded[i].size();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(TextureFileLevel));
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        static const char padding[16] = {};
+        std::streamoff position = file.tellp();
+        file.write(padding, static_cast<std::streamsize>(table[i].offset - position));
+        file.write(reinterpret_cast<const char*>(encoded[i].data()), encoded[i].size());
+    }
+    return static_cast<bool>(file);
+}
+
+// Контейнер, отображённый в память только для чтения
+class TextureFile {
+public:
+    TextureFile() = default;
+    ~TextureFile() { close(); }
+
+    TextureFile(const TextureFile&) = delete;
+    TextureFile& operator=(const TextureFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat info;
+        if (fstat(descriptor, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(TextureFileHeader))) {
+            void* mapping = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const unsigned char*>(mapping);
+                size = static_cast<std::size_t>(info.st_size);
+                // Файл будет прочитан целиком: страницы подкачиваются заранее
+                madvise(mapping, size, MADV_WILLNEED);
+            }
+        }
+        ::close(descriptor);
+        if (data && !validate()) {
+            close();
+            return false;
+        }
+        return data != nullptr;
+    }
+
+    void close() {
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    const TextureFileHeader& getHeader() const { return *reinterpret_cast<const TextureFileHeader*>(data); }
+    TextureFormat getFormat() const { return static_cast<TextureFormat>(getHeader().format); }
+
+    const TextureFileLevel& getLevel(std::size_t index) const {
+        return reinterpret_cast<const TextureFileLevel*>(data + sizeof(TextureFileHeader))[index];
+    }
+
+    const unsigned char* getLevelData(std::size_t index) const { return data + getLevel(index).offset; }
+
+private:
+    const unsigned char* data = nullptr;
+    std::size_t size = 0;
+
+    bool validate() const {
+        const TextureFileHeader& header = getHeader();
+        if (std::memcmp(header.magic, textureFileMagic, 4) != 0 || header.version != textureFileVersion
+            || header.format > static_cast<std::uint32_t>(TextureFormat::Bc5) || header.levelCount == 0)
+            return false;
+        if (sizeof(TextureFileHeader) + header.levelCount * sizeof(TextureFileLevel) > size)
+            return false;
+        // Размеры уровней должны образовывать мип-цепочку, а данные - совпадать
+        // по длине с тем, что прочитает glTexImage2D/glCompressedTexImage2D:
+        // иначе GL читал бы за концом отображения
+        if (header.width == 0 || header.height == 0 || header.levelCount > 32)
+            return false;
+        const TextureFormat format = getFormat();
+        for (std::uint32_t i = 0; i < header.levelCount; ++i) {
+            const TextureFileLevel& level = getLevel(i);
+            if (level.width != std::max(1u, header.width >> i) || level.height != std::max(1u, header.height >> i))
+                return false;
+            if (i > 0 && getLevel(i - 1).width == 1 && getLevel(i - 1).height == 1)
+                return false;
+            if (level.size != textureLevelBytes(format, level.width, level.height)
+                || level.size > static_cast<std::uint64_t>(std::numeric_limits<GLsizei>::max()))
+                return false;
+            if (level.offset > size || level.size > size - level.offset)
+                return false;
+        }
+        return true;
+    }
+};
+
+// Загруженная из контейнера текстура
+struct BakedTexture {
+    GLuint texture = 0;
+    TextureFormat format = TextureFormat::Rgba8;
+    std::size_t bytes = 0;
+};
+
+// Загрузка всех уровней прямо из отображения файла, без промежуточных копий
+// и без glGenerateMipmap. texture == 0, если файла нет или формат не поддержан.
+inline BakedTexture loadTextureFile(const std::string& path) {
+    BakedTexture baked;
+    TextureFile file;
+    if (!file.open(path))
+        return baked;
+    baked.format = file.getFormat();
+    if (baked.format == TextureFormat::Bc1 && !GLEW_EXT_texture_compression_s3tc)
+        return baked;
+
+    glGenTextures(1, &baked.texture);
+    glBindTexture(GL_TEXTURE_2D, baked.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const std::uint32_t levelCount = file.getHeader().levelCount;
+    for (std::uint32_t i = 0; i < levelCount; ++i) {
+        const TextureFileLevel& level = file.getLevel(i);
+        GLint index = static_cast<GLint>(i);
+        GLsizei width = static_cast<GLsizei>(level.width), height = static_cast<GLsizei>(level.height);
+        GLsizei size = static_cast<GLsizei>(level.size);
+        if (baked.format == TextureFormat::Bc1) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, index, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, width, height, 0, size, file.getLevelData(i));
+        } else if (baked.format == TextureFormat::Bc5) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, index, GL_COMPRESSED_RG_RGTC2, width, height, 0, size, file.getLevelData(i));
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, index, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, file.getLevelData(i));
+        }
+        baked.bytes += level.size;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levelCount) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return baked;
+}
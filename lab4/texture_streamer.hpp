@@ -0,0 +1,186 @@
+#pragma once
+#include <GL/glew.h>
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common/job_system.hpp"
+#include "texture_container.hpp"
+
+// Потоковая загрузка текстур. Файл декодируется и получает мип-цепочку в
+// собственном потоке декодирования, а в GL попадает в update() главного потока
+// полосами строк через кольцо PBO, не больше bytesPerFrame за кадр. Пока
+// текстура не загружена целиком, getTexture() отдаёт заглушку 1x1 нужного цвета.
+// Пул для декодирования отдельный: общий JobSystem::wait() выполняет любые
+// задачи очереди, и кадровый parallelFor главного потока мог бы взять декодирование.
+class TextureStreamer {
+public:
+    explicit TextureStreamer(std::size_t bytesPerFrame = 4 << 20) : bytesPerFrame(bytesPerFrame) {
+        glGenBuffers(pboCount, pbos);
+    }
+
+    ~TextureStreamer() {
+        for (const Record& record : records) {
+            if (record.texture)
+                glDeleteTextures(1, &record.texture);
+            glDeleteTextures(1, &record.placeholder);
+        }
+        glDeleteBuffers(pboCount, pbos);
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Постановка файла в очередь; placeholder - цвет заглушки RGBA
+    int request(const std::string& path, const unsigned char placeholder[4]) {
+        Record record;
+        glGenTextures(1, &record.placeholder);
+        glBindTexture(GL_TEXTURE_2D, record.placeholder);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        int handle = static_cast<int>(records.size());
+        records.push_back(record);
+        ++pending;
+        decoder.run(decoding, [this, path, handle] {
+            auto decoded = std::make_unique<Decoded>();
+            decoded->handle = handle;
+            sf::Image image;
+            if (image.loadFromFile(path)) {
+                decoded->levels = buildMipChain(image.getPixelsPtr(), static_cast<int>(image.getSize().x),
+                                                static_cast<int>(image.getSize().y));
+            } else {
+                decoded->error = "Failed to load texture " + path;
+            }
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(std::move(decoded));
+        });
+        return handle;
+    }
+
+    // Раз в кадр в потоке GL: приём декодированных текстур и порция загрузки.
+    // true, если загрузка меняла привязку GL_TEXTURE_2D активного блока
+    bool update() {
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            while (!ready.empty()) {
+                uploads.push_back(std::move(ready.front()));
+                ready.pop_front();
+            }
+        }
+
+        bool touched = false;
+        std::size_t budget = bytesPerFrame;
+        while (budget > 0 && !uploads.empty()) {
+            Decoded& upload = *uploads.front();
+            Record& record = records[upload.handle];
+            if (!upload.error.empty() || upload.levels.empty()) {
+                std::cerr << upload.error << std::endl;
+                finish();
+                continue;
+            }
+            if (!record.texture)
+                allocate(record, upload);
+            touched = true;
+
+            // Полоса строк текущего уровня, сколько позволяет бюджет (хотя бы одна строка)
+            const MipLevel& level = upload.levels[upload.level];
+            std::size_t rowBytes = static_cast<std::size_t>(level.width) * 4;
+            int rows = static_cast<int>(std::max<std::size_t>(1, budget / rowBytes));
+            rows = std::min(rows, level.height - upload.row);
+            std::size_t bytes = rowBytes * rows;
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+            nextPbo = (nextPbo + 1) % pboCount;
+            // "Сиротство" буфера: драйвер отдаёт новую память, не дожидаясь прошлой передачи
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (mapped) {
+                std::memcpy(mapped, level.pixels.data() + rowBytes * upload.row, bytes);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindTexture(GL_TEXTURE_2D, record.texture);
+                glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.row, level.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            budget = bytes < budget ? budget - bytes : 0;
+
+            upload.row += rows;
+            if (upload.row == level.height) {
+                upload.row = 0;
+                if (++upload.level == static_cast<int>(upload.levels.size())) {
+                    record.resident = true;
+                    finish();
+                }
+            }
+        }
+        return touched;
+    }
+
+    // Загруженная текстура или заглушка
+    GLuint getTexture(int handle) const {
+        const Record& record = records[handle];
+        return record.resident ? record.texture : record.placeholder;
+    }
+
+    bool isResident(int handle) const { return records[handle].resident; }
+
+    // Сколько запрошенных текстур ещё не загружено (включая неудачные в очереди)
+    std::size_t getPendingCount() const { return pending; }
+
+private:
+    struct Record {
+        GLuint texture = 0;
+        GLuint placeholder = 0;
+        bool resident = false;
+    };
+    struct Decoded {
+        int handle = 0;
+        std::vector<MipLevel> levels;
+        std::string error;
+        int level = 0;
+        int row = 0;
+    };
+
+    static constexpr int pboCount = 3;
+
+    std::size_t bytesPerFrame;
+    std::vector<Record> records;
+    std::size_t pending = 0;
+    std::mutex readyMutex;
+    std::deque<std::unique_ptr<Decoded>> ready;
+    std::deque<std::unique_ptr<Decoded>> uploads;
+    GLuint pbos[pboCount] = {};
+    int nextPbo = 0;
+    // Последними: decoder разрушается первым и доделывает задачи, пока ready ещё жив
+    JobSystem::Counter decoding;
+    JobSystem decoder{1};
+
+    // Память под все уровни без данных; выборка ограничена загружаемой цепочкой
+    void allocate(Record& record, const Decoded& upload) {
+        glGenTextures(1, &record.texture);
+        glBindTexture(GL_TEXTURE_2D, record.texture);
+        for (std::size_t i = 0; i < upload.levels.size(); ++i) {
+            const MipLevel& level = upload.levels[i];
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(upload.levels.size()) - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void finish() {
+        uploads.pop_front();
+        --pending;
+    }
+};
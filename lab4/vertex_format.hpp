@@ -0,0 +1,171 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "mesh.hpp"
+
+// Формат вершин, выбираемый при загрузке
+enum class VertexFormat {
+    Full,              // Vertex: 56 байт, все поля float
+    PackedHalfUv,      // 28 байт: float-позиция, нормаль/касательная snorm16 (октаэдр), half-UV
+    PackedQuantised,   // 20 байт: позиция snorm16 в рамке сетки, UV unorm16 в диапазоне сетки
+};
+
+// Упакованная сетка: сырые байты вершин и параметры обратного преобразования
+// для шейдера (PACKED_VERTICES). Нормаль и касательная кодируются октаэдром
+// в два snorm16, битангента восстанавливается как cross(N, T) * знак.
+// position = aPos * positionTransform.w + positionTransform.xyz
+// texCoord = aTexCoord * texCoordTransform.zw + texCoordTransform.xy
+struct PackedMesh {
+    VertexFormat format = VertexFormat::Full;
+    GLsizei stride = 0;
+    std::vector<unsigned char> data;
+    glm::vec4 positionTransform = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec4 texCoordTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+inline GLshort toSnorm16(float value) {
+    return static_cast<GLshort>(std::lround(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f));
+}
+
+inline GLushort toUnorm16(float value) {
+    return static_cast<GLushort>(std::lround(std::max(0.0f, std::min(1.0f, value)) * 65535.0f));
+}
+
+// float -> half с округлением к ближайшему; денормали сохраняются
+inline GLushort toHalf(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    std::uint32_t sign = (bits >> 16) & 0x8000u;
+    std::uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x7f800000u)   // inf, NaN
+        return static_cast<GLushort>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    if (magnitude >= 0x477ff000u)   // больше наибольшего half
+        return static_cast<GLushort>(sign | 0x7c00u);
+    if (magnitude < 0x38800000u) {  // денормаль half
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        return static_cast<GLushort>(sign | static_cast<std::uint32_t>(std::lround(absolute * 16777216.0f)));
+    }
+    std::uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13) & 1u) - (112u << 23);
+    return static_cast<GLushort>(sign | (rounded >> 13));
+}
+
+// Октаэдрическое кодирование единичного вектора в квадрат [-1, 1]^2
+inline glm::vec2 encodeOctahedral(glm::vec3 n) {
+    auto signNotZero = [](float v) { return v >= 0.0f ? 1.0f : -1.0f; };
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    n = n * (1.0f / sum);
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+    return glm::vec2((1.0f - std::fabs(n.y)) * signNotZero(n.x), (1.0f - std::fabs(n.x)) * signNotZero(n.y));
+}
+
+inline PackedMesh packVertices(const MeshData& mesh, VertexFormat format) {
+    PackedMesh packed;
+    packed.format = format;
+    if (format == VertexFormat::Full) {
+        packed.stride = sizeof(Vertex);
+        packed.data.resize(mesh.vertices.size() * sizeof(Vertex));
+        if (!mesh.vertices.empty())
+            std::memcpy(packed.data.data(), mesh.vertices.data(), packed.data.size());
+        return packed;
+    }
+
+    const bool quantised = format == VertexFormat::PackedQuantised;
+    packed.stride = quantised ? 20 : 28;
+    packed.data.resize(mesh.vertices.size() * packed.stride);
+
+    // Рамки позиций и UV для квантования (у позиций масштаб общий для осей)
+    glm::vec3 lo(0.0f), hi(0.0f);
+    float uvLo[2] = {0.0f, 0.0f}, uvHi[2] = {1.0f, 1.0f};
+    if (quantised && !mesh.vertices.empty()) {
+        const Vertex& first = mesh.vertices[0];
+        lo = hi = glm::vec3(first.position[0], first.position[1], first.position[2]);
+        uvLo[0] = uvHi[0] = first.texCoord[0];
+        uvLo[1] = uvHi[1] = first.texCoord[1];
+        for (const Vertex& v : mesh.vertices) {
+            glm::vec3 p(v.position[0], v.position[1], v.position[2]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+            for (int k = 0; k < 2; ++k) {
+                uvLo[k] = std::min(uvLo[k], v.texCoord[k]);
+                uvHi[k] = std::max(uvHi[k], v.texCoord[k]);
+            }
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        glm::vec3 extent = (hi - lo) * 0.5f;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        packed.positionTransform = glm::vec4(center, scale > 0.0f ? scale : 1.0f);
+        float uvScale[2];
+        for (int k = 0; k < 2; ++k)
+            uvScale[k] = uvHi[k] > uvLo[k] ? uvHi[k] - uvLo[k] : 1.0f;
+        packed.texCoordTransform = glm::vec4(uvLo[0], uvLo[1], uvScale[0], uvScale[1]);
+    }
+
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const Vertex& v = mesh.vertices[i];
+        unsigned char* out = &packed.data[i * packed.stride];
+        glm::vec3 n(v.normal[0], v.normal[1], v.normal[2]);
+        glm::vec3 t(v.tangent[0], v.tangent[1], v.tangent[2]);
+        glm::vec3 b(v.bitangent[0], v.bitangent[1], v.bitangent[2]);
+        GLshort handedness = glm::dot(glm::cross(n, t), b) < 0.0f ? -32767 : 32767;
+        glm::vec2 normalOct = encodeOctahedral(n);
+        glm::vec2 tangentOct = encodeOctahedral(t);
+        GLshort frame[4] = {toSnorm16(normalOct.x), toSnorm16(normalOct.y), toSnorm16(tangentOct.x), toSnorm16(tangentOct.y)};
+
+        if (quantised) {
+            GLshort position[4];
+            for (int k = 0; k < 3; ++k)
+                position[k] = toSnorm16((v.position[k] - packed.positionTransform[k]) / packed.positionTransform.w);
+            position[3] = handedness;
+            GLushort texCoord[2];
+            for (int k = 0; k < 2; ++k)
+                texCoord[k] = toUnorm16((v.texCoord[k] - packed.texCoordTransform[k]) / packed.texCoordTransform[k + 2]);
+            std::memcpy(out, position, 8);
+            std::memcpy(out + 8, frame, 8);
+            std::memcpy(out + 16, texCoord, 4);
+        } else {
+            GLushort texCoord[2] = {toHalf(v.texCoord[0]), toHalf(v.texCoord[1])};
+            GLshort sign[2] = {handedness, 0};
+            std::memcpy(out, v.position, 12);
+            std::memcpy(out + 12, frame, 8);
+            std::memcpy(out + 20, texCoord, 4);
+            std::memcpy(out + 24, sign, 4);
+        }
+    }
+    return packed;
+}
+
+// Атрибуты 0..4 для привязанного VAO и буфера вершин упакованной сетки
+inline void setupPackedAttributes(const PackedMesh& packed) {
+    auto at = [](std::size_t offset) { return reinterpret_cast<void*>(offset); };
+    const GLsizei stride = packed.stride;
+    if (packed.format == VertexFormat::Full) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, at(offsetof(Vertex, position)));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, at(offsetof(Vertex, texCoord)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, at(offsetof(Vertex, normal)));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, at(offsetof(Vertex, tangent)));
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, at(offsetof(Vertex, bitangent)));
+    } else if (packed.format == VertexFormat::PackedQuantised) {
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, at(0));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, at(16));
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, at(8));
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, at(12));
+        // Знак битангенты лежит в w позиции
+        glVertexAttribPointer(4, 1, GL_SHORT, GL_TRUE, stride, at(6));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, at(0));
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, at(20));
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, at(12));
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, at(16));
+        glVertexAttribPointer(4, 1, GL_SHORT, GL_TRUE, stride, at(24));
+    }
+    for (GLuint location = 0; location < 5; ++location)
+        glEnableVertexAttribArray(location);
+}
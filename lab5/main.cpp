@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include "../common/program_cache.hpp"
 
 int main() {
     const int width = 800;
@@ -13,8 +14,11 @@ int main() {
     window.setMouseCursorGrabbed(true);
     window.setMouseCursorVisible(false);
 
+    // Трассирующий шейдер компилируется долго: скомпонованная программа
+    // сохраняется в .shader_cache и со второго запуска берётся оттуда
+    ProgramCache programCache;
     sf::Shader shader;
-    if (!shader.loadFromFile("shader.frag", sf::Shader::Fragment)) {
+    if (!loadShaderCached(shader, "shader.frag", sf::Shader::Fragment, programCache)) {
         std::cerr << "Failed to load shader" << std::endl;
         return -1;
     }
@@ -0,0 +1,180 @@
+#version 330 core
+
+// Классификация тайлов экрана для адаптивной глубины трассировки.
+// Один фрагмент - один тайл tileSize x tileSize пикселей. По пяти первичным
+// лучам (углы и центр тайла) и их отражениям оцениваются контраст и энергия,
+// которую несут отскоки; в красный канал записывается нужная глубина трассировки.
+
+struct Ray {
+    vec3 origin;
+    vec3 direction;
+};
+
+struct Sphere {
+    vec3 center;
+    float radius;
+    vec3 color;
+    float reflectivity;
+};
+
+struct Plane {
+    vec3 point;
+    vec3 normal;
+    vec3 color;
+    float reflectivity;
+};
+
+struct Light {
+    vec3 position;
+    vec3 color;
+};
+
+uniform Sphere spheres[3];
+uniform Plane plane;
+uniform Light light;
+uniform vec3 cameraPos;
+uniform mat4 view;
+uniform int maxDepth;
+uniform int width;
+uniform int height;
+uniform int tileSize;
+uniform float contrastThreshold; // Разница яркости, начиная с которой тайл считается "занятым"
+uniform float attenuationThreshold; // Вклад отражения, ниже которого отскоки не считаются
+
+out vec4 FragColor;
+
+bool intersectSphere(const Ray ray, const Sphere sphere, out float t) {
+    vec3 oc = ray.origin - sphere.center;
+    float a = dot(ray.direction, ray.direction);
+    float b = 2.0 * dot(oc, ray.direction);
+    float c = dot(oc, oc) - sphere.radius * sphere.radius;
+    float discriminant = b * b - 4 * a * c;
+
+    if (discriminant < 0.0) return false;
+    t = (-b - sqrt(discriminant)) / (2.0 * a);
+    return t > 0.0;
+}
+
+bool intersectPlane(const Ray ray, const Plane plane, out float t) {
+    float denom = dot(plane.normal, ray.direction);
+    if (abs(denom) > 1e-6) {
+        t = dot(plane.point - ray.origin, plane.normal) / denom;
+        return t > 0.0;
+    }
+    return false;
+}
+
+// Ближайшее попадание луча: номер объекта (-1 - фон, 3 - плоскость), точка,
+// нормаль, отражательная способность и яркость освещения в точке, как в trace()
+// (фоновая подсветка, диффузная и бликовая составляющие)
+int shadeHit(const Ray ray, out vec3 hitPoint, out vec3 normal, out float reflectivity, out float luminance) {
+    float tHit = 1e20;
+    int object = -1;
+    for (int i = 0; i < 3; ++i) {
+        float t;
+        if (intersectSphere(ray, spheres[i], t) && t < tHit) {
+            tHit = t;
+            object = i;
+        }
+    }
+    float t;
+    if (intersectPlane(ray, plane, t) && t < tHit) {
+        tHit = t;
+        object = 3;
+    }
+
+    if (object < 0) {
+        reflectivity = 0.0;
+        luminance = 0.1;
+        return object;
+    }
+
+    hitPoint = ray.origin + ray.direction * tHit;
+    vec3 color;
+    if (object < 3) {
+        normal = normalize(hitPoint - spheres[object].center);
+        color = spheres[object].color;
+        reflectivity = spheres[object].reflectivity;
+    } else {
+        normal = plane.normal;
+        color = plane.color;
+        reflectivity = plane.reflectivity;
+    }
+    vec3 lightDir = normalize(light.position - hitPoint);
+    float diffuse = max(dot(normal, lightDir), 0.0);
+    float specular = pow(max(dot(-ray.direction, reflect(-lightDir, normal)), 0.0), 16);
+    luminance = dot(light.color * 0.1 + (diffuse + specular) * color, vec3(0.299, 0.587, 0.114));
+    return object;
+}
+
+void main() {
+    vec2 tileOrigin = floor(gl_FragCoord.xy) * float(tileSize);
+    vec2 offsets[5] = vec2[](vec2(0.5), vec2(tileSize - 0.5, 0.5), vec2(0.5, tileSize - 0.5),
+                             vec2(tileSize - 0.5), vec2(tileSize * 0.5));
+
+    int firstObject = -2;
+    int firstReflected = -2;
+    bool mixedObjects = false;
+    float maxReflectivity = 0.0;
+    float minLuminance = 1e20;
+    float maxLuminance = 0.0;
+    int depth = 1;
+    for (int i = 0; i < 5; ++i) {
+        vec2 uv = (tileOrigin + offsets[i]) / vec2(width, height) * 2.0 - 1.0;
+        Ray ray;
+        ray.origin = cameraPos;
+        ray.direction = normalize(vec3(uv, -1.0)) * mat3(view);
+
+        vec3 hitPoint;
+        vec3 normal;
+        float reflectivity;
+        float luminance;
+        int object = shadeHit(ray, hitPoint, normal, reflectivity, luminance);
+        if (firstObject == -2) {
+            firstObject = object;
+        } else if (object != firstObject) {
+            mixedObjects = true;
+        }
+        maxReflectivity = max(maxReflectivity, reflectivity);
+        minLuminance = min(minLuminance, luminance);
+        maxLuminance = max(maxLuminance, luminance);
+        if (reflectivity <= 0.0) {
+            continue;
+        }
+
+        // Первый отскок приносит reflectivity * яркость того, что видно в отражении.
+        // Для следующих известна только отражательная способность второй
+        // поверхности, яркость берётся наибольшей (1.0)
+        Ray reflected;
+        reflected.origin = hitPoint + normal * 1e-4;
+        reflected.direction = reflect(ray.direction, normal);
+        float nextReflectivity;
+        float nextLuminance;
+        int reflectedObject = shadeHit(reflected, hitPoint, normal, nextReflectivity, nextLuminance);
+        // На тайле видны отражения разных объектов - граница отражения
+        if (firstReflected == -2) {
+            firstReflected = reflectedObject;
+        } else if (reflectedObject != firstReflected) {
+            mixedObjects = true;
+        }
+        int bounces = 0;
+        if (reflectivity * nextLuminance >= attenuationThreshold) {
+            bounces = 1;
+            float carried = reflectivity * nextReflectivity;
+            while (carried >= attenuationThreshold && bounces < maxDepth) {
+                ++bounces;
+                carried *= nextReflectivity;
+            }
+        }
+        depth = max(depth, 1 + bounces);
+    }
+
+    // Границы объектов и контрастные отражающие участки трассируются полностью
+    bool busy = mixedObjects || maxLuminance - minLuminance > contrastThreshold;
+    if (busy && maxReflectivity > 0.0) {
+        depth = maxDepth;
+    }
+    depth = clamp(depth, 1, max(maxDepth, 1));
+
+    FragColor = vec4(float(depth) / 255.0, 0.0, 0.0, 1.0);
+}
@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <iomanip>
+#include "../common/program_cache.hpp"
 //g++ main.cpp -lGLEW -lGL -lGLU -lsfml-graphics -lsfml-window -lsfml-system -I/usr/include/glm
 
 // Функция проверки столкновений камеры со сферой
@@ -28,12 +29,21 @@ int main() {
     window.setMouseCursorGrabbed(true);
     window.setMouseCursorVisible(false);
 
+    // Образы обеих программ (трассировка и классификация тайлов) лежат в .shader_cache
+    ProgramCache programCache;
     sf::Shader shader;
-    if (!shader.loadFromFile("shader.frag", sf::Shader::Fragment)) {
+    if (!loadShaderCached(shader, "shader.frag", sf::Shader::Fragment, programCache)) {
         std::cerr << "Failed to load shader" << std::endl;
         return -1;
     }
 
+    // Предварительный проход: оценка нужной глубины трассировки для тайлов экрана
+    sf::Shader classifyShader;
+    if (!loadShaderCached(classifyShader, "classify.frag", sf::Shader::Fragment, programCache)) {
+        std::cerr << "Failed to load classify shader" << std::endl;
+        return -1;
+    }
+
     float cameraHeight = 1.5f; // Высота камеры (рост персонажа)
     glm::vec3 cameraPos(0, cameraHeight, 5);
     glm::vec3 initialCameraPos = cameraPos; // Сохранение начальной позиции камеры
@@ -60,25 +70,27 @@ int main() {
     glm::vec3 planeColor(0.5, 0.5, 0.5);
     float planeReflectivity = 0.3f;
 
-    shader.setUniform("cameraPos", sf::Glsl::Vec3(cameraPos.x, cameraPos.y, cameraPos.z));
-    shader.setUniform("spheres[0].center", sf::Glsl::Vec3(spheresCenter1.x, spheresCenter1.y, spheresCenter1.z));
-    shader.setUniform("spheres[0].radius", spheresRadius1);
-    shader.setUniform("spheres[0].color", sf::Glsl::Vec3(spheresColor1.x, spheresColor1.y, spheresColor1.z));
-    shader.setUniform("spheres[0].reflectivity", spheresReflectivity1);
-    shader.setUniform("spheres[1].center", sf::Glsl::Vec3(spheresCenter2.x, spheresCenter2.y, spheresCenter2.z));
-    shader.setUniform("spheres[1].radius", spheresRadius2);
-    shader.setUniform("spheres[1].color", sf::Glsl::Vec3(spheresColor2.x, spheresColor2.y, spheresColor2.z));
-    shader.setUniform("spheres[1].reflectivity", spheresReflectivity2);
-    shader.setUniform("spheres[2].center", sf::Glsl::Vec3(spheresCenter3.x, spheresCenter3.y, spheresCenter3.z)); // Добавление зелёного шара
-    shader.setUniform("spheres[2].radius", spheresRadius3);
-    shader.setUniform("spheres[2].color", sf::Glsl::Vec3(spheresColor3.x, spheresColor3.y, spheresColor3.z));
-    shader.setUniform("spheres[2].reflectivity", spheresReflectivity3);
-    shader.setUniform("plane.point", sf::Glsl::Vec3(planePoint.x, planePoint.y, planePoint.z));
-    shader.setUniform("plane.normal", sf::Glsl::Vec3(planeNormal.x, planeNormal.y, planeNormal.z));
-    shader.setUniform("plane.color", sf::Glsl::Vec3(planeColor.x, planeColor.y, planeColor.z));
-    shader.setUniform("plane.reflectivity", planeReflectivity);
-    shader.setUniform("light.position", sf::Glsl::Vec3(2, 5, -3));
-    shader.setUniform("light.color", sf::Glsl::Vec3(1, 1, 1));
+    for (sf::Shader* s : {&shader, &classifyShader}) {
+        s->setUniform("cameraPos", sf::Glsl::Vec3(cameraPos.x, cameraPos.y, cameraPos.z));
+        s->setUniform("spheres[0].center", sf::Glsl::Vec3(spheresCenter1.x, spheresCenter1.y, spheresCenter1.z));
+        s->setUniform("spheres[0].radius", spheresRadius1);
+        s->setUniform("spheres[0].color", sf::Glsl::Vec3(spheresColor1.x, spheresColor1.y, spheresColor1.z));
+        s->setUniform("spheres[0].reflectivity", spheresReflectivity1);
+        s->setUniform("spheres[1].center", sf::Glsl::Vec3(spheresCenter2.x, spheresCenter2.y, spheresCenter2.z));
+        s->setUniform("spheres[1].radius", spheresRadius2);
+        s->setUniform("spheres[1].color", sf::Glsl::Vec3(spheresColor2.x, spheresColor2.y, spheresColor2.z));
+        s->setUniform("spheres[1].reflectivity", spheresReflectivity2);
+        s->setUniform("spheres[2].center", sf::Glsl::Vec3(spheresCenter3.x, spheresCenter3.y, spheresCenter3.z)); // Добавление зелёного шара
+        s->setUniform("spheres[2].radius", spheresRadius3);
+        s->setUniform("spheres[2].color", sf::Glsl::Vec3(spheresColor3.x, spheresColor3.y, spheresColor3.z));
+        s->setUniform("spheres[2].reflectivity", spheresReflectivity3);
+        s->setUniform("plane.point", sf::Glsl::Vec3(planePoint.x, planePoint.y, planePoint.z));
+        s->setUniform("plane.normal", sf::Glsl::Vec3(planeNormal.x, planeNormal.y, planeNormal.z));
+        s->setUniform("plane.color", sf::Glsl::Vec3(planeColor.x, planeColor.y, planeColor.z));
+        s->setUniform("plane.reflectivity", planeReflectivity);
+        s->setUniform("light.position", sf::Glsl::Vec3(2, 5, -3));
+        s->setUniform("light.color", sf::Glsl::Vec3(1, 1, 1));
+    }
 
     sf::RenderTexture renderTexture;
     if (!renderTexture.create(width, height)) {
@@ -88,6 +100,23 @@ int main() {
 
     sf::Sprite sprite(renderTexture.getTexture());
 
+    // Карта тайлов: один пиксель на тайл, в красном канале - глубина трассировки
+    const int tileSize = 16;
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    sf::RenderTexture tileTexture;
+    if (!tileTexture.create(tilesX, tilesY)) {
+        std::cerr << "Failed to create tile texture" << std::endl;
+        return -1;
+    }
+    sf::RectangleShape tileQuad(sf::Vector2f(static_cast<float>(tilesX), static_cast<float>(tilesY)));
+    classifyShader.setUniform("tileSize", tileSize);
+    classifyShader.setUniform("contrastThreshold", 0.15f);
+    classifyShader.setUniform("attenuationThreshold", 1.0f / 32.0f);
+    shader.setUniform("tileSize", tileSize);
+    shader.setUniform("tileDepth", tileTexture.getTexture());
+    bool adaptiveDepth = true;
+
     sf::Mouse::setPosition(sf::Vector2i(window.getSize()) / 2, window);
 
     sf::Clock clock;
@@ -125,6 +154,9 @@ int main() {
             if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape) {
                 window.close();
             }
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::V) {
+                adaptiveDepth = !adaptiveDepth; // Переключение адаптивной глубины трассировки
+            }
             if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space && !isJumping) {
                 isJumping = true;
                 verticalSpeed = jumpSpeed;
@@ -224,15 +256,24 @@ int main() {
         // Обновление направления камеры
         cameraFront = glm::normalize(glm::vec3(cos(angleY), sin(angleZ), sin(angleY)));
 
-        shader.setUniform("cameraPos", sf::Glsl::Vec3(cameraPos.x, cameraPos.y, cameraPos.z));
-        shader.setUniform("spheres[0].reflectivity", spheresReflectivity1);
-        shader.setUniform("spheres[1].reflectivity", spheresReflectivity2);
-        shader.setUniform("spheres[2].reflectivity", spheresReflectivity3);
-        shader.setUniform("plane.reflectivity", planeReflectivity);
-        shader.setUniform("view", sf::Glsl::Mat4(glm::value_ptr(view)));
-        shader.setUniform("maxDepth", maxDepth);
-        shader.setUniform("width", width);
-        shader.setUniform("height", height);
+        for (sf::Shader* s : {&shader, &classifyShader}) {
+            s->setUniform("cameraPos", sf::Glsl::Vec3(cameraPos.x, cameraPos.y, cameraPos.z));
+            s->setUniform("spheres[0].reflectivity", spheresReflectivity1);
+            s->setUniform("spheres[1].reflectivity", spheresReflectivity2);
+            s->setUniform("spheres[2].reflectivity", spheresReflectivity3);
+            s->setUniform("plane.reflectivity", planeReflectivity);
+            s->setUniform("view", sf::Glsl::Mat4(glm::value_ptr(view)));
+            s->setUniform("maxDepth", maxDepth);
+            s->setUniform("width", width);
+            s->setUniform("height", height);
+        }
+        shader.setUniform("adaptiveDepth", adaptiveDepth);
+
+        if (adaptiveDepth) {
+            tileTexture.clear();
+            tileTexture.draw(tileQuad, &classifyShader);
+            tileTexture.display();
+        }
 
         renderTexture.clear();
         renderTexture.draw(sprite, &shader);
@@ -249,7 +290,7 @@ int main() {
 
         // Отображение значения maxDepth
         if (maxDepth > 0) {
-            maxDepthText.setString("Max Depth of Ray Tracing: " + std::to_string(maxDepth));
+            maxDepthText.setString("Max Depth of Ray Tracing: " + std::to_string(maxDepth) + (adaptiveDepth ? " (adaptive)" : ""));
         } else {
             maxDepthText.setString("Ray Tracing disabled");
         }
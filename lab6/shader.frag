@@ -34,6 +34,9 @@ uniform int width;
 uniform int height;
 uniform float teleportDistance; // Расстояние для телепортации
 uniform vec3 initialCameraPos; // Начальная позиция камеры
+uniform bool adaptiveDepth; // Глубина трассировки берётся из карты тайлов
+uniform sampler2D tileDepth; // Результат classify.frag: глубина в красном канале
+uniform int tileSize;
 
 out vec4 FragColor;
 
@@ -58,11 +61,11 @@ bool intersectPlane(const Ray ray, const Plane plane, out float t) {
     return false;
 }
 
-vec3 trace(Ray ray) {
+vec3 trace(Ray ray, int depthLimit) {
     vec3 finalColor = vec3(0.0);
     vec3 attenuation = vec3(1.0);
 
-    for (int depth = 0; depth < (maxDepth > 0 ? maxDepth : 1); ++depth) {
+    for (int depth = 0; depth < depthLimit; ++depth) {
         float tSphere = 1e20;
         float tPlane = 1e20;
         Sphere hitSphere;
@@ -148,6 +151,12 @@ void main() {
     ray.origin = cameraPos;
     ray.direction = direction;
 
-    vec3 color = trace(ray);
+    int depthLimit = maxDepth > 0 ? maxDepth : 1;
+    if (adaptiveDepth) {
+        int tileLimit = int(texelFetch(tileDepth, ivec2(gl_FragCoord.xy) / tileSize, 0).r * 255.0 + 0.5);
+        depthLimit = clamp(tileLimit, 1, depthLimit);
+    }
+
+    vec3 color = trace(ray, depthLimit);
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file